@@ -0,0 +1,45 @@
+#version 330
+
+// Draws every bird from one copy of the bird mesh: the mesh attributes are
+// the same for all birds, the in_bird_* ones advance once per bird.
+uniform mat4 u_model;
+uniform mat4 u_view_projection;
+uniform float u_bird_scale;
+
+// bird3.obj, modelled looking down -z
+in vec4 in_position;
+in vec4 in_normal;
+in vec4 in_tangent;
+in vec2 in_uv;
+
+// per bird
+in vec3 in_bird_position;
+in vec3 in_bird_direction; // unit speed
+
+out vec4 v_position;
+out vec4 v_normal;
+out vec2 v_uv;
+out vec4 v_tangent;
+
+// Rotation taking -z to dir about the normal of the two.
+mat3 rotationTo(vec3 dir) {
+  vec3 forward = vec3(0, 0, -1);
+  vec3 axis = cross(forward, dir);
+  // (anti)parallel to -z: any normal works, y turns -z around to +z
+  axis = dot(axis, axis) > 1e-12 ? normalize(axis) : vec3(0, 1, 0);
+  mat3 from = mat3(forward, axis, cross(axis, forward));
+  mat3 to = mat3(dir, axis, cross(axis, dir));
+  return to * transpose(from);
+}
+
+void main() {
+  mat3 rotation = rotationTo(in_bird_direction);
+  vec4 position = vec4(in_bird_position + rotation * in_position.xyz * u_bird_scale, 1);
+
+  v_position = u_model * position;
+  v_normal = normalize(u_model * vec4(rotation * in_normal.xyz, 0));
+  v_uv = in_uv;
+  v_tangent = normalize(u_model * in_tangent);
+
+  gl_Position = u_view_projection * u_model * position;
+}
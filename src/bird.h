@@ -4,17 +4,18 @@
 #include <vector>
 
 #include "CGL/CGL.h"
-#include "pointMass.h"
+#include "flockState.h"
 
 using namespace std;
 
 namespace CGL {
 
 	struct Bird {
-		Bird(PointMass* a) : pm_a(a) {
+		Bird(BirdHandle handle) : handle(handle) {
 		}
 
-		PointMass* pm_a;
+		// the bird in Flock::state, see FlockState::indexOf
+		BirdHandle handle;
 	};
 }
 #endif /* Bird_H */
\ No newline at end of file
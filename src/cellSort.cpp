@@ -0,0 +1,129 @@
+#include "cellSort.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+// Plain counting sort by cell. cell_start[c] first counts and then ends cell
+// c, and the backwards fill walks it down to the start, so the sort needs no
+// scratch array and keeps each cell in bird order.
+static void countingSort(const int *bird_cell, int n, int num_cells, vector<int> &cell_start,
+                         vector<int> &entries)
+{
+  cell_start.assign(num_cells + 1, 0);
+  for (int i = 0; i < n; i++)
+  {
+    cell_start[bird_cell[i]]++;
+  }
+  for (int c = 1; c < num_cells; c++)
+  {
+    cell_start[c] += cell_start[c - 1];
+  }
+  cell_start[num_cells] = n;
+  for (int i = n - 1; i >= 0; i--)
+  {
+    entries[--cell_start[bird_cell[i]]] = i;
+  }
+}
+
+void CellSort::sort(const int *bird_cell, int n, int num_cells, vector<int> &cell_start, vector<int> &entries)
+{
+  entries.resize(n);
+  int max_threads = 1;
+#ifdef _OPENMP
+  max_threads = omp_get_max_threads();
+#endif
+  if (n < MIN_PARALLEL_BIRDS || max_threads == 1)
+  {
+    countingSort(bird_cell, n, num_cells, cell_start, entries);
+    return;
+  }
+
+  cell_start.resize(num_cells + 1);
+  keys.resize(n);
+  swap.resize(n);
+  int passes = 0;
+  while (passes * RADIX_BITS < 32 && ((uint64_t)(num_cells - 1) >> (passes * RADIX_BITS)) != 0)
+  {
+    passes++;
+  }
+  histograms.resize((size_t)max_threads * RADIX);
+
+  uint64_t *from = keys.data(), *to = swap.data();
+  #pragma omp parallel
+  {
+    int thread = 0, num_threads = 1;
+#ifdef _OPENMP
+    thread = omp_get_thread_num();
+    num_threads = omp_get_num_threads();
+#endif
+    int begin = (int)((long)n * thread / num_threads);
+    int end = (int)((long)n * (thread + 1) / num_threads);
+    int *histogram = histograms.data() + (size_t)thread * RADIX;
+    // every thread walks the same pointers, swapped in the same places
+    uint64_t *src = from, *dst = to;
+
+    for (int i = begin; i < end; i++)
+    {
+      src[i] = (uint64_t)bird_cell[i] << 32 | (uint32_t)i;
+    }
+
+    for (int pass = 0; pass < passes; pass++)
+    {
+      int shift = 32 + pass * RADIX_BITS;
+      for (int d = 0; d < RADIX; d++)
+      {
+        histogram[d] = 0;
+      }
+      for (int i = begin; i < end; i++)
+      {
+        histogram[(src[i] >> shift) & (RADIX - 1)]++;
+      }
+      #pragma omp barrier
+      #pragma omp single
+      {
+        int offset = 0;
+        for (int d = 0; d < RADIX; d++)
+        {
+          for (int t = 0; t < num_threads; t++)
+          {
+            int count = histograms[(size_t)t * RADIX + d];
+            histograms[(size_t)t * RADIX + d] = offset;
+            offset += count;
+          }
+        }
+      }
+      for (int i = begin; i < end; i++)
+      {
+        dst[histogram[(src[i] >> shift) & (RADIX - 1)]++] = src[i];
+      }
+      #pragma omp barrier
+      uint64_t *done = dst;
+      dst = src;
+      src = done;
+    }
+
+    // Cell c starts at the first key of a cell >= c.
+    #pragma omp for schedule(static)
+    for (int k = 0; k < n; k++)
+    {
+      int cell = (int)(src[k] >> 32);
+      int previous = k == 0 ? -1 : (int)(src[k - 1] >> 32);
+      for (int c = previous + 1; c <= cell; c++)
+      {
+        cell_start[c] = k;
+      }
+      entries[k] = (int)(uint32_t)src[k];
+    }
+    #pragma omp single
+    {
+      int last = n == 0 ? -1 : (int)(src[n - 1] >> 32);
+      for (int c = last + 1; c <= num_cells; c++)
+      {
+        cell_start[c] = n;
+      }
+    }
+  }
+}
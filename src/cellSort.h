@@ -0,0 +1,35 @@
+#ifndef CELL_SORT_H
+#define CELL_SORT_H
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Parallel counting sort of birds by cell, shared by SpatialGrid and
+// SpatialHash.
+//
+// A cell-by-thread histogram would need threads * cells counters, too many
+// for a fine grid on many cores, so the cells are sorted as a stable LSD
+// radix sort on (cell, bird) keys instead. Each pass takes per-thread
+// histograms of one digit over a contiguous chunk of birds, a prefix sum in
+// digit-major, thread-minor order, and a scatter. The result is the birds
+// ordered by cell and then by index, the same for any number of threads.
+// Small flocks and single threads take a plain counting sort, which gives
+// the same order without the extra passes.
+struct CellSort {
+  // On return, the birds of cell c are entries[cell_start[c] ..
+  // cell_start[c + 1]). bird_cell[i] must be in [0, num_cells).
+  void sort(const int *bird_cell, int n, int num_cells, vector<int> &cell_start, vector<int> &entries);
+
+  static const int RADIX_BITS = 11;
+  static const int RADIX = 1 << RADIX_BITS;
+  // Below this many birds one thread does the whole sort.
+  static const int MIN_PARALLEL_BIRDS = 8192;
+
+  // scratch, kept between sorts
+  vector<uint64_t> keys, swap;
+  vector<int> histograms; // RADIX counters per thread
+};
+
+#endif /* CELL_SORT_H */
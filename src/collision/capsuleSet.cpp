@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <cmath>
+
+#include "capsuleSet.h"
+
+// Like the steering kernels, the AVX2 kernel is compiled with a per-function
+// target attribute and picked at run time.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CAPSULE_SET_X86
+#include <immintrin.h>
+#endif
+
+// Where the padding capsules sit: out of reach of any bird, but near enough
+// that squared distances stay finite in float.
+static const float PADDING_POSITION = 1e15f;
+
+void CapsuleSet::clear()
+{
+  count = 0;
+  ax.clear();
+  ay.clear();
+  az.clear();
+  dx.clear();
+  dy.clear();
+  dz.clear();
+  dd.clear();
+  inv_dd.clear();
+  radius.clear();
+}
+
+void CapsuleSet::add(const Vector3D &a, const Vector3D &b, double r)
+{
+  // drop the padding, append, and pad again
+  ax.resize(count);
+  ay.resize(count);
+  az.resize(count);
+  dx.resize(count);
+  dy.resize(count);
+  dz.resize(count);
+  dd.resize(count);
+  inv_dd.resize(count);
+  radius.resize(count);
+
+  float d[3] = {(float)(b.x - a.x), (float)(b.y - a.y), (float)(b.z - a.z)};
+  float length2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+  ax.push_back(a.x);
+  ay.push_back(a.y);
+  az.push_back(a.z);
+  dx.push_back(d[0]);
+  dy.push_back(d[1]);
+  dz.push_back(d[2]);
+  dd.push_back(length2);
+  inv_dd.push_back(length2 > 0 ? 1 / length2 : 0);
+  radius.push_back(r);
+  count++;
+
+  while (ax.size() % LANES)
+  {
+    ax.push_back(PADDING_POSITION);
+    ay.push_back(PADDING_POSITION);
+    az.push_back(PADDING_POSITION);
+    dx.push_back(0);
+    dy.push_back(0);
+    dz.push_back(0);
+    dd.push_back(0);
+    inv_dd.push_back(0);
+    radius.push_back(0);
+  }
+}
+
+namespace {
+
+struct CapsuleArrays {
+  const float *ax, *ay, *az;
+  const float *dx, *dy, *dz;
+  const float *dd, *inv_dd;
+  const float *radius;
+  size_t padded_size;
+};
+
+// One bird's path, from p along v.
+struct BirdPath {
+  float px, py, pz;
+  float vx, vy, vz;
+  float vv, inv_vv; // inv_vv is 0 for a bird at rest
+  float radius;
+};
+
+// Index of the first capsule hit, or -1, with the fraction of the path at
+// which its closest approach is.
+typedef int (*FirstHit)(const CapsuleArrays &capsules, const BirdPath &bird, float &s);
+
+inline float clamp01(float x)
+{
+  return std::min(std::max(x, 0.f), 1.f);
+}
+
+// Closest points of the bird's path (at s) and capsule k's segment (at t),
+// as in Ericson's segment-segment distance, clamping s to the path and t to
+// the segment. Returns their squared distance.
+inline float approach(const CapsuleArrays &capsules, size_t k, const BirdPath &bird, float &s)
+{
+  float wx = bird.px - capsules.ax[k];
+  float wy = bird.py - capsules.ay[k];
+  float wz = bird.pz - capsules.az[k];
+  float dx = capsules.dx[k], dy = capsules.dy[k], dz = capsules.dz[k];
+  float b = bird.vx * dx + bird.vy * dy + bird.vz * dz;
+  float c = bird.vx * wx + bird.vy * wy + bird.vz * wz;
+  float f = dx * wx + dy * wy + dz * wz;
+  float e = capsules.dd[k];
+  float denom = bird.vv * e - b * b;
+  // parallel (or a bird at rest): any s will do
+  s = denom > 0 ? clamp01((b * f - c * e) / denom) : 0;
+  float t = (b * s + f) * capsules.inv_dd[k];
+  if (t < 0)
+  {
+    t = 0;
+    s = clamp01(-c * bird.inv_vv);
+  }
+  else if (t > 1)
+  {
+    t = 1;
+    s = clamp01((b - c) * bird.inv_vv);
+  }
+  float ex = wx + bird.vx * s - dx * t;
+  float ey = wy + bird.vy * s - dy * t;
+  float ez = wz + bird.vz * s - dz * t;
+  return ex * ex + ey * ey + ez * ez;
+}
+
+BirdPath pathOf(const BirdSpan &birds, size_t i, float bird_radius)
+{
+  BirdPath bird;
+  bird.px = birds.px[i];
+  bird.py = birds.py[i];
+  bird.pz = birds.pz[i];
+  bird.vx = birds.vx[i];
+  bird.vy = birds.vy[i];
+  bird.vz = birds.vz[i];
+  bird.vv = bird.vx * bird.vx + bird.vy * bird.vy + bird.vz * bird.vz;
+  bird.inv_vv = bird.vv > 0 ? 1 / bird.vv : 0;
+  bird.radius = bird_radius;
+  return bird;
+}
+
+int firstHitScalar(const CapsuleArrays &capsules, const BirdPath &bird, float &best_s)
+{
+  int best = -1;
+  best_s = 2;
+  for (size_t k = 0; k < capsules.padded_size; k++)
+  {
+    float s;
+    float d2 = approach(capsules, k, bird, s);
+    float r = capsules.radius[k] + bird.radius;
+    if (d2 < r * r && s < best_s)
+    {
+      best = k;
+      best_s = s;
+    }
+  }
+  return best;
+}
+
+#ifdef CAPSULE_SET_X86
+
+// approach() for 8 capsules, operation for operation.
+__attribute__((target("avx2")))
+int firstHitAvx2(const CapsuleArrays &capsules, const BirdPath &bird, float &best_s)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1);
+  const __m256 sign = _mm256_set1_ps(-0.f);
+  const __m256 px = _mm256_set1_ps(bird.px);
+  const __m256 py = _mm256_set1_ps(bird.py);
+  const __m256 pz = _mm256_set1_ps(bird.pz);
+  const __m256 vx = _mm256_set1_ps(bird.vx);
+  const __m256 vy = _mm256_set1_ps(bird.vy);
+  const __m256 vz = _mm256_set1_ps(bird.vz);
+  const __m256 vv = _mm256_set1_ps(bird.vv);
+  const __m256 inv_vv = _mm256_set1_ps(bird.inv_vv);
+  const __m256 bird_radius = _mm256_set1_ps(bird.radius);
+  __m256 lane_s = _mm256_set1_ps(2);
+  __m256i lane_best = _mm256_set1_epi32(-1);
+  __m256i k = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i step = _mm256_set1_epi32(8);
+
+  for (size_t j = 0; j < capsules.padded_size; j += 8, k = _mm256_add_epi32(k, step))
+  {
+    __m256 dx = _mm256_load_ps(capsules.dx + j);
+    __m256 dy = _mm256_load_ps(capsules.dy + j);
+    __m256 dz = _mm256_load_ps(capsules.dz + j);
+    __m256 wx = _mm256_sub_ps(px, _mm256_load_ps(capsules.ax + j));
+    __m256 wy = _mm256_sub_ps(py, _mm256_load_ps(capsules.ay + j));
+    __m256 wz = _mm256_sub_ps(pz, _mm256_load_ps(capsules.az + j));
+    __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, dx), _mm256_mul_ps(vy, dy)), _mm256_mul_ps(vz, dz));
+    __m256 c = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, wx), _mm256_mul_ps(vy, wy)), _mm256_mul_ps(vz, wz));
+    __m256 f = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, wx), _mm256_mul_ps(dy, wy)), _mm256_mul_ps(dz, wz));
+    __m256 e = _mm256_load_ps(capsules.dd + j);
+    __m256 denom = _mm256_sub_ps(_mm256_mul_ps(vv, e), _mm256_mul_ps(b, b));
+    __m256 s = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(b, f), _mm256_mul_ps(c, e)), denom);
+    s = _mm256_min_ps(_mm256_max_ps(s, zero), one);
+    s = _mm256_and_ps(s, _mm256_cmp_ps(denom, zero, _CMP_GT_OQ));
+    __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(b, s), f), _mm256_load_ps(capsules.inv_dd + j));
+    __m256 below = _mm256_cmp_ps(t, zero, _CMP_LT_OQ);
+    __m256 above = _mm256_cmp_ps(t, one, _CMP_GT_OQ);
+    __m256 s_below = _mm256_mul_ps(_mm256_xor_ps(c, sign), inv_vv);
+    __m256 s_above = _mm256_mul_ps(_mm256_sub_ps(b, c), inv_vv);
+    s_below = _mm256_min_ps(_mm256_max_ps(s_below, zero), one);
+    s_above = _mm256_min_ps(_mm256_max_ps(s_above, zero), one);
+    s = _mm256_blendv_ps(_mm256_blendv_ps(s, s_below, below), s_above, above);
+    t = _mm256_blendv_ps(_mm256_blendv_ps(t, zero, below), one, above);
+    __m256 ex = _mm256_sub_ps(_mm256_add_ps(wx, _mm256_mul_ps(vx, s)), _mm256_mul_ps(dx, t));
+    __m256 ey = _mm256_sub_ps(_mm256_add_ps(wy, _mm256_mul_ps(vy, s)), _mm256_mul_ps(dy, t));
+    __m256 ez = _mm256_sub_ps(_mm256_add_ps(wz, _mm256_mul_ps(vz, s)), _mm256_mul_ps(dz, t));
+    __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)), _mm256_mul_ps(ez, ez));
+    __m256 r = _mm256_add_ps(_mm256_load_ps(capsules.radius + j), bird_radius);
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(r, r), _CMP_LT_OQ), _mm256_cmp_ps(s, lane_s, _CMP_LT_OQ));
+    lane_s = _mm256_blendv_ps(lane_s, s, hit);
+    lane_best = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(lane_best), _mm256_castsi256_ps(k), hit));
+  }
+
+  // earliest over the lanes, the lowest index among equals, as the scalar
+  // loop would have it
+  float ss[8];
+  int bests[8];
+  _mm256_storeu_ps(ss, lane_s);
+  _mm256_storeu_si256((__m256i *)bests, lane_best);
+  int best = -1;
+  best_s = 2;
+  for (int lane = 0; lane < 8; lane++)
+  {
+    if (bests[lane] >= 0 && (ss[lane] < best_s || (ss[lane] == best_s && bests[lane] < best)))
+    {
+      best = bests[lane];
+      best_s = ss[lane];
+    }
+  }
+  return best;
+}
+
+// The same for birds i .. i + 7 against the capsules one at a time, which
+// suits runs of birds better: no reduction over the lanes at the end.
+__attribute__((target("avx2")))
+void firstHitsAvx2(const CapsuleArrays &capsules, size_t count, const BirdSpan &birds, size_t i,
+                   float bird_radius, int *best, float *best_s)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1);
+  const __m256 sign = _mm256_set1_ps(-0.f);
+  const __m256 px = _mm256_loadu_ps(birds.px + i);
+  const __m256 py = _mm256_loadu_ps(birds.py + i);
+  const __m256 pz = _mm256_loadu_ps(birds.pz + i);
+  const __m256 vx = _mm256_loadu_ps(birds.vx + i);
+  const __m256 vy = _mm256_loadu_ps(birds.vy + i);
+  const __m256 vz = _mm256_loadu_ps(birds.vz + i);
+  const __m256 vv = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(vz, vz));
+  const __m256 inv_vv = _mm256_and_ps(_mm256_div_ps(one, vv), _mm256_cmp_ps(vv, zero, _CMP_GT_OQ));
+  const __m256 bird_radius_v = _mm256_set1_ps(bird_radius);
+  __m256 lane_s = _mm256_set1_ps(2);
+  __m256i lane_best = _mm256_set1_epi32(-1);
+
+  for (size_t k = 0; k < count; k++)
+  {
+    __m256 dx = _mm256_set1_ps(capsules.dx[k]);
+    __m256 dy = _mm256_set1_ps(capsules.dy[k]);
+    __m256 dz = _mm256_set1_ps(capsules.dz[k]);
+    __m256 wx = _mm256_sub_ps(px, _mm256_set1_ps(capsules.ax[k]));
+    __m256 wy = _mm256_sub_ps(py, _mm256_set1_ps(capsules.ay[k]));
+    __m256 wz = _mm256_sub_ps(pz, _mm256_set1_ps(capsules.az[k]));
+    __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, dx), _mm256_mul_ps(vy, dy)), _mm256_mul_ps(vz, dz));
+    __m256 c = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, wx), _mm256_mul_ps(vy, wy)), _mm256_mul_ps(vz, wz));
+    __m256 f = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, wx), _mm256_mul_ps(dy, wy)), _mm256_mul_ps(dz, wz));
+    __m256 e = _mm256_set1_ps(capsules.dd[k]);
+    __m256 denom = _mm256_sub_ps(_mm256_mul_ps(vv, e), _mm256_mul_ps(b, b));
+    __m256 s = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(b, f), _mm256_mul_ps(c, e)), denom);
+    s = _mm256_min_ps(_mm256_max_ps(s, zero), one);
+    s = _mm256_and_ps(s, _mm256_cmp_ps(denom, zero, _CMP_GT_OQ));
+    __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(b, s), f), _mm256_set1_ps(capsules.inv_dd[k]));
+    __m256 below = _mm256_cmp_ps(t, zero, _CMP_LT_OQ);
+    __m256 above = _mm256_cmp_ps(t, one, _CMP_GT_OQ);
+    __m256 s_below = _mm256_mul_ps(_mm256_xor_ps(c, sign), inv_vv);
+    __m256 s_above = _mm256_mul_ps(_mm256_sub_ps(b, c), inv_vv);
+    s_below = _mm256_min_ps(_mm256_max_ps(s_below, zero), one);
+    s_above = _mm256_min_ps(_mm256_max_ps(s_above, zero), one);
+    s = _mm256_blendv_ps(_mm256_blendv_ps(s, s_below, below), s_above, above);
+    t = _mm256_blendv_ps(_mm256_blendv_ps(t, zero, below), one, above);
+    __m256 ex = _mm256_sub_ps(_mm256_add_ps(wx, _mm256_mul_ps(vx, s)), _mm256_mul_ps(dx, t));
+    __m256 ey = _mm256_sub_ps(_mm256_add_ps(wy, _mm256_mul_ps(vy, s)), _mm256_mul_ps(dy, t));
+    __m256 ez = _mm256_sub_ps(_mm256_add_ps(wz, _mm256_mul_ps(vz, s)), _mm256_mul_ps(dz, t));
+    __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)), _mm256_mul_ps(ez, ez));
+    __m256 r = _mm256_add_ps(_mm256_set1_ps(capsules.radius[k]), bird_radius_v);
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(r, r), _CMP_LT_OQ), _mm256_cmp_ps(s, lane_s, _CMP_LT_OQ));
+    lane_s = _mm256_blendv_ps(lane_s, s, hit);
+    lane_best = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(lane_best),
+                                                     _mm256_castsi256_ps(_mm256_set1_epi32((int)k)), hit));
+  }
+  _mm256_storeu_ps(best_s, lane_s);
+  _mm256_storeu_si256((__m256i *)best, lane_best);
+}
+
+#endif // CAPSULE_SET_X86
+
+// Bounces the bird off capsule k, whose closest approach is at s.
+void respond(const CapsuleArrays &capsules, int k, const BirdPath &bird, float s, float friction,
+             BirdSpan &birds, size_t i)
+{
+  Vector3D a(capsules.ax[k], capsules.ay[k], capsules.az[k]);
+  Vector3D d(capsules.dx[k], capsules.dy[k], capsules.dz[k]);
+  Vector3D position(bird.px, bird.py, bird.pz);
+  Vector3D speed(bird.vx, bird.vy, bird.vz);
+  double r = capsules.radius[k] + bird.radius;
+
+  Vector3D q = position + speed * s;
+  Vector3D normal = q - (a + d * CGL::clamp(dot(q - a, d) * capsules.inv_dd[k], 0., 1.));
+  if (normal.norm2() > 0)
+  {
+    normal.normalize();
+  }
+  else if (speed.norm2() > 0)
+  {
+    // straight through the axis
+    normal = -speed.unit();
+  }
+  double into = dot(speed, normal);
+  if (into < 0)
+  {
+    Vector3D along = speed - into * normal;
+    birds.setSpeed(i, along * (1 - friction) - into * normal);
+  }
+
+  Vector3D axis_point = a + d * CGL::clamp(dot(position - a, d) * capsules.inv_dd[k], 0., 1.);
+  Vector3D out = position - axis_point;
+  if (out.norm2() < r * r && out.norm2() > 0)
+  {
+    birds.setPosition(i, axis_point + out.unit() * r);
+  }
+}
+
+} // namespace
+
+SteeringKernelType CapsuleSet::kernelType(SteeringKernelType requested)
+{
+#ifdef CAPSULE_SET_X86
+  // the steering kernel of a level exists when the build and the CPU can run it
+  static const bool has_avx2 = steeringKernel(STEERING_KERNEL_AVX2) != nullptr;
+  if (requested >= STEERING_KERNEL_AVX2 && has_avx2)
+  {
+    return STEERING_KERNEL_AVX2;
+  }
+#endif
+  return STEERING_KERNEL_SCALAR;
+}
+
+int CapsuleSet::collide(BirdSpan &birds, size_t begin, size_t end, float bird_radius, float friction,
+                        SteeringKernelType type) const
+{
+  if (count == 0)
+  {
+    return 0;
+  }
+  CapsuleArrays capsules = {ax.data(), ay.data(), az.data(), dx.data(), dy.data(), dz.data(),
+                            dd.data(), inv_dd.data(), radius.data(), ax.size()};
+  int hits = 0;
+  size_t i = begin;
+  FirstHit firstHit = firstHitScalar;
+#ifdef CAPSULE_SET_X86
+  if (kernelType(type) == STEERING_KERNEL_AVX2)
+  {
+    // whole groups of birds in the lanes, the rest a bird at a time with the
+    // capsules in the lanes
+    for (; i + LANES <= end; i += LANES)
+    {
+      int best[LANES];
+      float best_s[LANES];
+      firstHitsAvx2(capsules, count, birds, i, bird_radius, best, best_s);
+      for (int lane = 0; lane < LANES; lane++)
+      {
+        if (best[lane] >= 0)
+        {
+          respond(capsules, best[lane], pathOf(birds, i + lane, bird_radius), best_s[lane], friction, birds, i + lane);
+          hits++;
+        }
+      }
+    }
+    firstHit = firstHitAvx2;
+  }
+#endif
+
+  for (; i < end; i++)
+  {
+    BirdPath bird = pathOf(birds, i, bird_radius);
+    float s;
+    int k = firstHit(capsules, bird, s);
+    if (k >= 0)
+    {
+      respond(capsules, k, bird, s, friction, birds, i);
+      hits++;
+    }
+  }
+  return hits;
+}
@@ -0,0 +1,55 @@
+#ifndef COLLISIONOBJECT_CAPSULE_SET_H
+#define COLLISIONOBJECT_CAPSULE_SET_H
+
+#include "CGL/vector3D.h"
+#include "../flockState.h"
+#include "../misc/aligned_allocator.h"
+#include "../steeringKernel.h"
+
+using namespace CGL;
+
+// Capsules (segments with a radius) in structure-of-arrays form, so that
+// AVX2 tests 8 birds against a capsule at a time, or a bird against 8
+// capsules when there are fewer than 8 birds left.
+//
+// A bird is a sphere swept from its position along its speed. It hits a
+// capsule when the closest approach of that path to the capsule's segment
+// comes within the two radii, and the first capsule along the path is the
+// one whose closest approach comes earliest. The test is done in float with
+// separate multiplies and adds, so the scalar and the AVX2 kernels find the
+// same hits.
+class CapsuleSet {
+public:
+  void clear();
+  void add(const Vector3D &a, const Vector3D &b, double radius);
+  size_t size() const { return count; }
+
+  // Bounces birds [begin, end) off the first capsule each of them hits: the
+  // part of the speed into the capsule is reflected and the rest scaled by
+  // 1 - friction, and a bird that starts inside is moved onto the surface.
+  // Returns how many birds hit.
+  int collide(BirdSpan &birds, size_t begin, size_t end, float bird_radius, float friction) const
+  {
+    return collide(birds, begin, end, bird_radius, friction, steeringKernelType());
+  }
+  // The same with the kernel of the given SIMD level (the same FLOCK_SIMD
+  // choice as the steering kernel), falling back to scalar.
+  int collide(BirdSpan &birds, size_t begin, size_t end, float bird_radius, float friction,
+              SteeringKernelType type) const;
+
+  // The kernel collide() runs for a requested level: AVX2 for AVX2 and up.
+  static SteeringKernelType kernelType(SteeringKernelType requested);
+
+  static const int LANES = 8;
+
+private:
+  size_t count = 0;
+  // start, start to end, its squared length and the radius; padded to a
+  // multiple of LANES with capsules far out of any bird's reach
+  Misc::AlignedVector<float> ax, ay, az;
+  Misc::AlignedVector<float> dx, dy, dz;
+  Misc::AlignedVector<float> dd, inv_dd; // inv_dd is 0 for a segment of length 0
+  Misc::AlignedVector<float> radius;
+};
+
+#endif /* COLLISIONOBJECT_CAPSULE_SET_H */
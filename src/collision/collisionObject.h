@@ -1,18 +1,33 @@
 #ifndef COLLISIONOBJECT
 #define COLLISIONOBJECT
 
+#ifndef FLOCK_HEADLESS
 #include <nanogui/nanogui.h>
+#endif
 
 #include "../flockMesh.h"
+#include "../flockState.h"
 
 using namespace CGL;
 using namespace std;
+#ifndef FLOCK_HEADLESS
 using namespace nanogui;
+#endif
 
+// Built with FLOCK_HEADLESS (see the flock_headless target) the collision
+// objects keep only their simulation side and never touch nanogui or GL.
 class CollisionObject {
 public:
+  virtual ~CollisionObject() {}
+
+#ifndef FLOCK_HEADLESS
   virtual void render(GLShader &shader) = 0;
-  virtual void collide(PointMass &pm) = 0;
+#endif
+  // Adjusts the speeds (or positions) of birds [begin, end) of the given
+  // buffer, each on its own.
+  virtual void collide(BirdSpan &birds, size_t begin, size_t end) = 0;
+  // The same for bird i alone.
+  virtual void collide(BirdSpan &birds, size_t i) { collide(birds, i, i + 1); }
 
 private:
   double friction;
@@ -1,12 +1,21 @@
 #ifndef COLLISIONOBJECT_CYLINDER_H
 #define COLLISIONOBJECT_CYLINDER_H
 
+#ifndef FLOCK_HEADLESS
 #include <nanogui/nanogui.h>
+#endif
 
+#include "CGL/matrix3x3.h"
 #include "../flockMesh.h"
+#include "capsuleSet.h"
+#ifndef FLOCK_HEADLESS
+#include "../misc/static_mesh.h"
+#endif
 #include "collisionObject.h"
 
+#ifndef FLOCK_HEADLESS
 using namespace nanogui;
+#endif
 using namespace CGL;
 using namespace std;
 
@@ -14,10 +23,17 @@ struct Cylinder : public CollisionObject {
 public:
   Cylinder();
   Cylinder(const vector<Vector3D> &points, const vector<vector<double> > &rotates, const vector<double> &radius, const vector<double> &halfLength, int slices, double friction, int branchNum, int poleNum)
-      : points(points), rotates(rotates), radius(radius), halfLength(halfLength), slices(slices), friction(friction), branchNum(branchNum), poleNum(poleNum){}
+      : points(points), rotates(rotates), radius(radius), halfLength(halfLength), slices(slices), friction(friction), branchNum(branchNum), poleNum(poleNum)
+  {
+    buildPerchLines();
+    buildCapsules();
+  }
 
+#ifndef FLOCK_HEADLESS
   void render(GLShader &shader);
-  void collide(PointMass &pm);
+#endif
+  using CollisionObject::collide;
+  void collide(BirdSpan &birds, size_t begin, size_t end);
 
   vector<Vector3D> points;
   vector<vector<double> > rotates;
@@ -25,12 +41,37 @@ public:
   vector<double> halfLength;
   int slices;
   double friction;
-  vector<vector<Vector3f> > stopLine;
+  // The upper edge of a branch, where birds perch.
+  struct PerchLine {
+    Vector3D top;
+    Vector3D bottom;
+    Vector3D axis; // unit, from top to bottom
+    double length;
+  };
+  // one per branch, filled on construction
+  vector<PerchLine> perchLines;
 
-  Vector3D getProjected(Vector3D A, Vector3D B, Vector3D C);
-  double computeDistance(Vector3D A, Vector3D B, Vector3D C);
+  // distance from p to the line through the perch of `branch`
+  double computeDistance(const Vector3D &p, int branch) const;
+  // rotation of cylinder `index` from its local frame (axis along y)
+  Matrix3x3 rotation(int index);
+  // the same for a {z, y} pair of angles in degrees, as in rotates
+  static Matrix3x3 rotation(const vector<double> &rotate);
+  void buildPerchLines();
+  // every cylinder as a capsule, for collide()
+  CapsuleSet capsules;
+  void buildCapsules();
+  // radius of the sphere a bird collides as
+  static const float BIRD_RADIUS;
   int branchNum;
   int poleNum;
+
+#ifndef FLOCK_HEADLESS
+private:
+  // all cylinders in one buffer, built on the first render
+  void buildMesh();
+  Misc::StaticMesh mesh;
+#endif
 };
 
 #endif /* COLLISIONOBJECT_CYLINDER_H */
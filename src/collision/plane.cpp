@@ -1,8 +1,12 @@
 #include "iostream"
+#ifndef FLOCK_HEADLESS
 #include <nanogui/nanogui.h>
+#endif
 
 #include "../flockMesh.h"
+#ifndef FLOCK_HEADLESS
 #include "../flockSimulator.h"
+#endif
 #include "plane.h"
 
 using namespace std;
@@ -10,45 +14,37 @@ using namespace CGL;
 
 #define SURFACE_OFFSET 0.0001
 
-void Plane::collide(PointMass &pm) {
-  // TODO (Part 3): Handle collisions with planes.
-    Vector3D newPosition = pm.position + pm.speed;
-    if (newPosition.y < 0.0 ) {
-      pm.speed.y = pm.speed.y * -1;
-    }
+void Plane::collide(BirdSpan &birds, size_t begin, size_t end) {
+  // The ground: a bird about to go below it turns back up. Written without
+  // a branch so the loop vectorizes.
+  float *py = birds.py;
+  float *vy = birds.vy;
+  #pragma omp simd
+  for (size_t i = begin; i < end; i++) {
+    float newY = py[i] + vy[i];
+    vy[i] = newY < 0.0f ? -vy[i] : vy[i];
+  }
 }
 
+#ifndef FLOCK_HEADLESS
 void Plane::render(GLShader &shader) {
   nanogui::Color color(0.7f, 0.7f, 0.7f, 1.0f);
 
-  Vector3f sPoint1(point1.x, point1.y, point1.z);
-  Vector3f sPoint2(point2.x, point2.y, point2.z);
-  Vector3f sPoint3(point3.x, point3.y, point3.z);
-  Vector3f sPoint4(point4.x, point4.y, point4.z);
-  Vector3f sNormal(normal.x, normal.y, normal.z);
-  Vector3f sParallel(normal.y - normal.z, normal.z - normal.x,
-                     normal.x - normal.y);
-  sParallel.normalize();
-  Vector3f sCross = sNormal.cross(sParallel);
-
-  MatrixXf positions(3, 4);
-  MatrixXf normals(3, 4);
-
-//  positions.col(0) << sPoint + 2 * (sCross + sParallel);
-//  positions.col(1) << sPoint + 2 * (sCross - sParallel);
-//  positions.col(2) << sPoint + 2 * (-sCross + sParallel);
-//  positions.col(3) << sPoint + 2 * (-sCross - sParallel);
-  
-  positions.col(0) << sPoint1;
-  positions.col(1) << sPoint2;
-  positions.col(2) << sPoint3;
-  positions.col(3) << sPoint4;
+  if (!mesh.numVertices()) {
+    vector<float> positions = {
+      (float)point1.x, (float)point1.y, (float)point1.z,
+      (float)point2.x, (float)point2.y, (float)point2.z,
+      (float)point3.x, (float)point3.y, (float)point3.z,
+      (float)point4.x, (float)point4.y, (float)point4.z,
+    };
+    vector<float> normals;
+    for (int i = 0; i < 4; i++) {
+      normals.insert(normals.end(), {(float)normal.x, (float)normal.y, (float)normal.z});
+    }
+    mesh.addAttrib("in_position", 3, positions);
+    mesh.addAttrib("in_normal", 3, normals);
+  }
 
-  normals.col(0) << sNormal;
-  normals.col(1) << sNormal;
-  normals.col(2) << sNormal;
-  normals.col(3) << sNormal;
-  
   Matrix4f model;
   model.setIdentity();
   shader.setUniform("u_model", model);
@@ -56,10 +52,6 @@ void Plane::render(GLShader &shader) {
   if (shader.uniform("u_color", false) != -1) {
     shader.setUniform("u_color", color);
   }
-  shader.uploadAttrib("in_position", positions);
-  if (shader.attrib("in_normal", false) != -1) {
-    shader.uploadAttrib("in_normal", normals);
-  }
-
-  shader.drawArray(GL_TRIANGLE_STRIP, 0, 4);
+  mesh.draw(shader, GL_TRIANGLE_STRIP);
 }
+#endif // FLOCK_HEADLESS
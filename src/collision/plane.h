@@ -1,12 +1,19 @@
 #ifndef COLLISIONOBJECT_PLANE_H
 #define COLLISIONOBJECT_PLANE_H
 
+#ifndef FLOCK_HEADLESS
 #include <nanogui/nanogui.h>
+#endif
 
 #include "../flockMesh.h"
+#ifndef FLOCK_HEADLESS
+#include "../misc/static_mesh.h"
+#endif
 #include "collisionObject.h"
 
+#ifndef FLOCK_HEADLESS
 using namespace nanogui;
+#endif
 using namespace CGL;
 using namespace std;
 
@@ -17,8 +24,11 @@ public:
       : point1(point1), point2(point2), point3(point3), point4(point4),
   normal(normal.unit()), friction(friction) {}
 
+#ifndef FLOCK_HEADLESS
   void render(GLShader &shader);
-  void collide(PointMass &pm);
+#endif
+  using CollisionObject::collide;
+  void collide(BirdSpan &birds, size_t begin, size_t end);
 
   Vector3D point1;
   Vector3D point2;
@@ -27,6 +37,11 @@ public:
   Vector3D normal;
 
   double friction;
+
+#ifndef FLOCK_HEADLESS
+private:
+  Misc::StaticMesh mesh;
+#endif
 };
 
 #endif /* COLLISIONOBJECT_PLANE_H */
@@ -1,23 +1,38 @@
+#ifndef FLOCK_HEADLESS
 #include <nanogui/nanogui.h>
+#endif
 
 #include "../flockMesh.h"
+#ifndef FLOCK_HEADLESS
 #include "../misc/sphere_drawing.h"
+#endif
 #include "sphere.h"
 
+#ifndef FLOCK_HEADLESS
 using namespace nanogui;
+#endif
 using namespace CGL;
 
-void Sphere::collide(PointMass &pm) {
-  // TODO (Part 3): Handle collisions with spheres.
-	if ((pm.position - origin).norm() <= radius) {
-		Vector3D tangent_point = (pm.position - origin).unit() * radius + origin;
-		Vector3D correction = tangent_point - pm.last_position;
-		pm.position = pm.last_position + (1 - friction) * correction;
-	}
+void Sphere::collide(BirdSpan &birds, size_t begin, size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    double dx = birds.px[i] - origin.x;
+    double dy = birds.py[i] - origin.y;
+    double dz = birds.pz[i] - origin.z;
+    if (!(sqrt(dx * dx + dy * dy + dz * dz) <= radius)) {
+      continue;
+    }
+    Vector3D position = birds.position(i);
+    const Vector3D &last_position = birds.cold[i].last_position;
+    Vector3D tangent_point = (position - origin).unit() * radius + origin;
+    Vector3D correction = tangent_point - last_position;
+    birds.setPosition(i, last_position + (1 - friction) * correction);
+  }
 }
 
+#ifndef FLOCK_HEADLESS
 void Sphere::render(GLShader &shader) {
   // We decrease the radius here so flat triangles don't behave strangely
   // and intersect with the sphere when rendered
   m_sphere_mesh.draw_sphere(shader, origin, radius * 0.92);
 }
+#endif // FLOCK_HEADLESS
@@ -2,7 +2,9 @@
 #define COLLISIONOBJECT_SPHERE_H
 
 #include "../flockMesh.h"
+#ifndef FLOCK_HEADLESS
 #include "../misc/sphere_drawing.h"
+#endif
 #include "collisionObject.h"
 
 using namespace CGL;
@@ -12,10 +14,17 @@ struct Sphere : public CollisionObject {
 public:
   Sphere(const Vector3D &origin, double radius, double friction, int num_lat = 40, int num_lon = 40)
       : origin(origin), radius(radius), radius2(radius * radius),
-        friction(friction), m_sphere_mesh(Misc::SphereMesh(num_lat, num_lon)) {}
+        friction(friction)
+#ifndef FLOCK_HEADLESS
+        , m_sphere_mesh(Misc::SphereMesh(num_lat, num_lon))
+#endif
+  {}
 
+#ifndef FLOCK_HEADLESS
   void render(GLShader &shader);
-  void collide(PointMass &pm);
+#endif
+  using CollisionObject::collide;
+  void collide(BirdSpan &birds, size_t begin, size_t end);
 
 private:
   Vector3D origin;
@@ -23,8 +32,10 @@ private:
   double radius2;
 
   double friction;
-  
+
+#ifndef FLOCK_HEADLESS
   Misc::SphereMesh m_sphere_mesh;
+#endif
 };
 
 #endif /* COLLISIONOBJECT_SPHERE_H */
@@ -1,10 +1,14 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <limits>
 #include <math.h>
 #include <random>
 #include <vector>
 #include <random>
 #include <stdlib.h>
 #include "flock.h"
+#include "steeringKernel.h"
 #include "collision/plane.h"
 #include "collision/sphere.h"
 #include "collision/cylinder.h"
@@ -21,106 +25,266 @@ Flock::Flock(double width, double height, int num_width_points,
   this->num_height_points = num_height_points;
   this->thickness = thickness;
   buildGrid();
-  buildFlockMesh();
 }
 
 Flock::~Flock()
 {
-  point_masses.clear();
+  state.clear();
   springs.clear();
   birds.clear();
-  if (flockMesh)
-  {
-    delete flockMesh;
-  }
 }
 
-Vector3D Flock::generatePos()
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Which draw of a bird's step a random number is for, see FlockRandom.
+enum RandomSlot
+{
+  RANDOM_POS_X, RANDOM_POS_Y, RANDOM_POS_Z,
+  RANDOM_SPEED_X, RANDOM_SPEED_Y, RANDOM_SPEED_Z,
+  RANDOM_BRANCH,
+  RANDOM_STOP_FRAC,
+  RANDOM_TOGGLE_STOP
+};
+
+Vector3D Flock::generatePos(size_t bird) const
 {
   double x, y, z;
-  x = (double)(rand() % 100) / 100.;
-  y = (double)(rand() % 100) / 100.;
-  z = (double)(rand() % 100) / 100.;
+  x = rng.uniform(bird, step_count, RANDOM_POS_X);
+  y = rng.uniform(bird, step_count, RANDOM_POS_Y);
+  z = rng.uniform(bird, step_count, RANDOM_POS_Z);
   return Vector3D(x, y, z);
 }
 
-void initializeSpeed(PointMass *pm)
+Vector3D initializeSpeed(const BirdSpecies &species, const FlockRandom &rng, size_t bird, uint64_t step)
 {
   double sx, sy, sz;
-  sx = -pm->maxSpeed + rand() / (RAND_MAX / (pm->maxSpeed + pm->maxSpeed));
-  sy = -pm->maxSpeed + rand() / (RAND_MAX / (pm->maxSpeed + pm->maxSpeed));
-  sz = -pm->maxSpeed + rand() / (RAND_MAX / (pm->maxSpeed + pm->maxSpeed));
-  pm->speed = Vector3D(sx, sy, sz);
-  Vector3D dir = pm->speed;
+  sx = rng.uniform(-species.maxSpeed, species.maxSpeed, bird, step, RANDOM_SPEED_X);
+  sy = rng.uniform(-species.maxSpeed, species.maxSpeed, bird, step, RANDOM_SPEED_Y);
+  sz = rng.uniform(-species.maxSpeed, species.maxSpeed, bird, step, RANDOM_SPEED_Z);
+  Vector3D speed = Vector3D(sx, sy, sz);
+  Vector3D dir = speed;
   dir.normalize();
-  pm->speed = dir * CGL::clamp(pm->speed.norm(), pm->minSpeed, pm->maxSpeed);
+  return dir * CGL::clamp(speed.norm(), species.minSpeed, species.maxSpeed);
 }
 
 void Flock::buildGrid()
 {
+  spawn_birds(num_birds);
+}
 
-  for (int i = 0; i < num_birds; i += 1)
+void Flock::spawn_birds(size_t count)
+{
+  auto start = chrono::steady_clock::now();
+  // Positions are drawn for all new birds at once, one coordinate at a time.
+  // New birds get the next ids, so first + i is the id of the i-th.
+  size_t first = state.size();
+  spawn_x.resize(count);
+  spawn_y.resize(count);
+  spawn_z.resize(count);
+  rng.fill(spawn_x.data(), count, 0, 1, first, step_count, RANDOM_POS_X);
+  rng.fill(spawn_y.data(), count, 0, 1, first, step_count, RANDOM_POS_Y);
+  rng.fill(spawn_z.data(), count, 0, 1, first, step_count, RANDOM_POS_Z);
+  if (state.px.capacity() < first + count)
   {
-    PointMass pm = PointMass(generatePos(), false);
-    pm.able_stop = false;
-    initializeSpeed(&pm);
-    point_masses.emplace_back(pm);
+    state.reserve(max(first + count, 2 * first));
   }
-
-  PointMass *a;
-  for (int i = 0; i < point_masses.size(); i++)
+  for (size_t i = 0; i < count; i++)
   {
-    a = &point_masses[i];
-    point_masses[i].rand_stop_pos = NULL;
-    birds.emplace_back(Bird(a));
+    Vector3D pos = Vector3D(spawn_x[i], spawn_y[i], spawn_z[i]);
+    size_t index = state.add(pos, initializeSpeed(state.species[0], rng, first + i, step_count));
+    birds.emplace_back(Bird(state.handle(index)));
   }
+  neighbour_grid.invalidate();
+  neighbour_stats.spawned += count;
+  neighbour_stats.population_seconds += secondsSince(start);
 }
 
-vector<PointMass> Flock::getNeighbours(PointMass pm, double range)
+void Flock::despawn_birds(size_t count)
 {
-  vector<PointMass> npms;
-  for (PointMass &p : point_masses)
-  {
-    double dis = (p.position - pm.position).norm();
-    if (dis < range && &p != &pm)
+  auto start = chrono::steady_clock::now();
+  count = min(count, state.size());
+  state.pop_back(count);
+  birds.resize(state.size(), Bird(BirdHandle()));
+  neighbour_grid.invalidate();
+  neighbour_stats.despawned += count;
+  neighbour_stats.population_seconds += secondsSince(start);
+}
+
+vector<vector<int> > Flock::getNeighbours(int index, const vector<double> &range)
+{
+  vector<vector<int> > vecs(range.size());
+  Vector3D pos = state.position(index);
+  neighbour_grid.query(pos, [&](int j) {
+    if (j == index)
     {
-      PointMass temp = PointMass(p.position, false);
-      temp.speed = p.speed;
-      npms.push_back(temp);
+      return;
     }
-  }
-  return npms;
+    double dis = (state.position(j) - pos).norm();
+    for (size_t i = 0; i < range.size(); i++)
+    {
+      if (dis < range[i])
+      {
+        vecs[i].push_back(j);
+      }
+    }
+  });
+  return vecs;
 }
 
-vector<vector<PointMass *> > Flock::getNeighbours(PointMass pm, vector<double> range)
+vector<vector<int> > Flock::getNeighboursBruteForce(int index, const vector<double> &range)
 {
-  vector<PointMass *> n1, n2, n3;
-  vector<vector<PointMass *> > vecs = vector<vector<PointMass *> >({n1, n2, n3});
-  for (PointMass &p : point_masses)
+  vector<vector<int> > vecs(range.size());
+  Vector3D pos = state.position(index);
+  for (int j = 0; j < (int)state.size(); j++)
   {
-    double dis = (p.position - pm.position).norm();
-    for (int i = 0; i < 3; i++)
+    if (j == index)
+    {
+      continue;
+    }
+    double dis = (state.position(j) - pos).norm();
+    for (size_t i = 0; i < range.size(); i++)
     {
-      if (dis < range[i] && &p != &pm)
+      if (dis < range[i])
       {
-        vecs[i].push_back(&p);
+        vecs[i].push_back(j);
       }
     }
   }
   return vecs;
 }
-Vector3D normalizeForce(Vector3D acceleration, PointMass pm)
+
+void Flock::build_neighbour_grid(double cell_size)
+{
+  auto start = chrono::steady_clock::now();
+  if (!incremental_grid)
+  {
+    neighbour_grid.build(state, cell_size);
+  }
+  else
+  {
+    int migrations = neighbour_grid.update(state, cell_size);
+    if (migrations >= 0)
+    {
+      neighbour_stats.grid_updates++;
+      neighbour_stats.migrations += migrations;
+    }
+  }
+  neighbour_stats.grid_builds++;
+  neighbour_stats.grid_seconds += secondsSince(start);
+}
+
+void Flock::update_neighbours(double radius)
+{
+  neighbour_stats.steps++;
+  auto start = chrono::steady_clock::now();
+  if (neighbour_skin <= 0)
+  {
+    build_neighbour_grid(radius);
+    neighbour_list.is_valid = false;
+    neighbour_stats.rebuilds++;
+    neighbour_stats.rebuild_seconds += secondsSince(start);
+    return;
+  }
+
+  if (neighbour_list.needsRebuild(state, radius, neighbour_skin))
+  {
+    if (reorder_interval == REORDER_ADAPTIVE)
+    {
+      reorder_birds();
+    }
+    start = chrono::steady_clock::now();
+    build_neighbour_grid(radius + neighbour_skin);
+    if (!neighbour_list.build(state, neighbour_grid, radius, neighbour_skin))
+    {
+      neighbour_stats.overflows++;
+    }
+    neighbour_stats.rebuilds++;
+    neighbour_stats.rebuild_seconds += secondsSince(start);
+  }
+  else
+  {
+    // Too many pairs for lists: fall back to a fresh grid every step.
+    if (!neighbour_list.valid())
+    {
+      build_neighbour_grid(radius + neighbour_skin);
+    }
+    neighbour_stats.check_seconds += secondsSince(start);
+  }
+}
+
+// Spreads the low 10 bits of v two bits apart, for Morton codes.
+static uint32_t spreadBits(uint32_t v)
+{
+  v &= 0x3ff;
+  v = (v | (v << 16)) & 0x030000ff;
+  v = (v | (v << 8)) & 0x0300f00f;
+  v = (v | (v << 4)) & 0x030c30c3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+
+void Flock::reorder_birds()
+{
+  auto start = chrono::steady_clock::now();
+  int n = state.size();
+  const float *pos[3] = {state.px.data(), state.py.data(), state.pz.data()};
+  float lo[3], scale[3];
+  for (int k = 0; k < 3; k++)
+  {
+    float low = numeric_limits<float>::max(), high = -numeric_limits<float>::max();
+    for (int i = 0; i < n; i++)
+    {
+      low = min(low, pos[k][i]);
+      high = max(high, pos[k][i]);
+    }
+    lo[k] = low;
+    scale[k] = high > low ? 1023.f / (high - low) : 0.f;
+  }
+
+  // Birds are sorted by the Morton code of their cell in a 1024^3 lattice
+  // over the flock, ties (and NaN positions, which land in cell 0) by index.
+  morton_keys.resize(n);
+  #pragma omp parallel for
+  for (int i = 0; i < n; i++)
+  {
+    uint32_t code = 0;
+    for (int k = 0; k < 3; k++)
+    {
+      float f = (pos[k][i] - lo[k]) * scale[k];
+      uint32_t cell = f > 0 ? (uint32_t)min(f, 1023.f) : 0;
+      code |= spreadBits(cell) << k;
+    }
+    morton_keys[i] = (uint64_t)code << 32 | (uint32_t)i;
+  }
+  sort(morton_keys.begin(), morton_keys.end());
+  morton_order.resize(n);
+  for (int k = 0; k < n; k++)
+  {
+    morton_order[k] = (int)(morton_keys[k] & 0xffffffff);
+  }
+  state.permute(morton_order);
+  neighbour_list.invalidate();
+  neighbour_grid.invalidate();
+  neighbour_stats.reorders++;
+  neighbour_stats.reorder_seconds += secondsSince(start);
+}
+
+Vector3D normalizeForce(Vector3D acceleration, const BirdSpecies &species)
 {
 
     Vector3D accDir = Vector3D(acceleration.x, acceleration.y, acceleration.z);
     if (accDir.norm() != 0) {
         accDir.normalize();
     }
-    return accDir * CGL::clamp(acceleration.norm(), pm.minAcc/3., pm.maxAcc/3.);
+    return accDir * CGL::clamp(acceleration.norm(), species.minAcc/3., species.maxAcc/3.);
 
 }
 
-void change_state_random(PointMass& pm) {
+// prob is uniform in [0, 1)
+void change_state_random(BirdColdState& pm, double prob) {
     double thresh;
     if (pm.able_stop) {
         thresh = 0.0001;
@@ -129,37 +293,55 @@ void change_state_random(PointMass& pm) {
         thresh = 0.00001;
     }
     
-    double prob = rand() / (RAND_MAX);
     if (prob < thresh) {
         pm.able_stop = !pm.able_stop;
-        pm.rand_stop_pos = NULL;
+        pm.has_stop_pos = false;
+    }
+}
+
+// Passes the flying birds of [begin, end) to every collision object, a run of
+// consecutive ones at a time. Returns how many there were.
+static int collideFlying(BirdSpan &birds, int begin, int end, const bool *flying,
+                         const vector<CollisionObject *> &collision_objects)
+{
+  int count = 0;
+  int run = begin;
+  while (run < end)
+  {
+    if (!flying[run - begin])
+    {
+      run++;
+      continue;
+    }
+    int run_end = run + 1;
+    while (run_end < end && flying[run_end - begin])
+    {
+      run_end++;
+    }
+    for (CollisionObject *collision_object : collision_objects)
+    {
+      collision_object->collide(birds, run, run_end);
     }
+    count += run_end - run;
+    run = run_end;
+  }
+  return count;
 }
 
 void Flock::simulate(double frames_per_sec, double simulation_steps, FlockParameters *fp,
-                     vector<Vector3D> external_accelerations,
+                     const vector<Vector3D> &external_accelerations,
                      vector<CollisionObject *> *collision_objects,
                      Vector3D windDir, bool is_stopped)
 {
-  // need more birds
   Cylinder *cylinder = dynamic_cast<Cylinder *>(collision_objects->at(0));
-  vector<vector<Vector3f> > stopLine = cylinder->stopLine;
-  if (fp->num_birds > point_masses.size())
+  // reach the requested population in one step
+  if (fp->num_birds > (int)state.size())
   {
-    // only add one bird at one frame
-    point_masses.emplace_back(PointMass(generatePos(), false));
-    PointMass *a;
-    a = &point_masses[point_masses.size()-1];
-    birds.emplace_back(Bird(a));
+    spawn_birds(fp->num_birds - state.size());
   }
-  else if (fp->num_birds < point_masses.size())
-  { // remove extra birds
-    int extra = point_masses.size() - fp->num_birds;
-    for (int i = 0; i < extra; i += 1)
-    {
-      point_masses.pop_back();
-      birds.pop_back();
-    }
+  else if (fp->num_birds < (int)state.size())
+  {
+    despawn_birds(state.size() - fp->num_birds);
   }
 
   double cw, sw, aw, dw;
@@ -169,146 +351,204 @@ void Flock::simulate(double frames_per_sec, double simulation_steps, FlockParame
   sw = separation_weight / sum;
   aw = alignment_weight / sum;
   dw = dweight / sum;
-  for (PointMass &point_mass : point_masses)
+  if (reorder_interval > 0 ? step_count % reorder_interval == 0
+                           : reorder_interval == REORDER_ADAPTIVE && (octree_mode || neighbour_skin <= 0) &&
+                                 step_count % ADAPTIVE_REORDER_STEPS == 0)
   {
-    // if "S" is not pressed or bird is not within 0.5 distance from bar, not affected by
-    // stopping behavior
-    if (point_mass.branch == -1) {
-      point_mass.branch = rand() % cylinder->branchNum;
-    }
-    vector<Vector3f> line = stopLine[point_mass.branch];
-    Vector3D a(line[0][0], line[0][1], line[0][2]);
-    Vector3D b(line[1][0], line[1][1], line[1][2]);
-    double dis = cylinder->computeDistance(point_mass.position, a, b);
-    if (!is_stopped || !point_mass.able_stop || dis > 0.5) // || !(point_mass.position[1] > a[1] && point_mass.position[1] > b[1]))
+    reorder_birds();
+  }
+  if (octree_mode)
+  {
+    auto start = chrono::steady_clock::now();
+    octree.build(state);
+    neighbour_list.is_valid = false;
+    neighbour_stats.steps++;
+    neighbour_stats.rebuilds++;
+    neighbour_stats.rebuild_seconds += secondsSince(start);
+  }
+  else
+  {
+    update_neighbours(max(fp->coherence, max(fp->separation, fp->alignment)));
+  }
+  SteeringKernel accumulate = steeringKernel();
+  int num = state.size();
+
+  // Every bird reads the front buffer of the whole flock and writes only its
+  // own slot of the back buffer and of the cold state, and its random numbers
+  // depend only on (seed, bird, step), so the birds can be updated in any
+  // order. They go in blocks: steered, then passed through the collision
+  // objects together, then moved.
+  BirdSpan back = state.backSpan();
+  auto steering_start = chrono::steady_clock::now();
+  double collision_seconds = 0;
+  long collided = 0;
+  #pragma omp parallel for schedule(dynamic, 1) reduction(+ : collision_seconds, collided)
+  for (int block = 0; block < num; block += COLLISION_BLOCK)
+  {
+    int block_end = min(block + COLLISION_BLOCK, num);
+    // perching birds fly themselves onto their branch and skip the collisions
+    bool flying[COLLISION_BLOCK];
+    double perch_distance[COLLISION_BLOCK];
+    for (int index = block; index < block_end; index++)
     {
-      vector<double> pars = vector<double>({fp->coherence, fp->separation, fp->alignment});
-      vector<vector<PointMass *> > vecs = getNeighbours(point_mass, pars);
-      Vector3D goal = Vector3D();
-      if (following)
-      {
-        double newCenterX = cursor.position.x * point_masses.size() - point_mass.position.x;
-        double newCenterY = cursor.position.y * point_masses.size() - point_mass.position.y;
-        double newCenterZ = cursor.position.z * point_masses.size() - point_mass.position.z;
-        Vector3D newCenter = Vector3D(newCenterX, newCenterY, newCenterZ) / (point_masses.size() - 1);
-        Vector3D goal = (newCenter - point_mass.position);
-        point_mass.cumulatedSpeed += normalizeForce(goal, point_mass) * cw;
+      BirdColdState &cold = state.cold[index];
+      const BirdSpecies &species = state.speciesOf(index);
+      Vector3D position = state.position(index);
+      uint32_t bird = state.id[index];
+      if (cold.branch == -1) {
+        cold.branch = rng.uniformInt(cylinder->branchNum, bird, step_count, RANDOM_BRANCH);
       }
-      else
+      // if "S" is not pressed or bird is not within 0.5 distance from bar, not affected by
+      // stopping behavior
+      const Vector3D &a = cylinder->perchLines[cold.branch].top;
+      const Vector3D &b = cylinder->perchLines[cold.branch].bottom;
+      double dis = cylinder->computeDistance(position, cold.branch);
+      if (!is_stopped || !cold.able_stop || dis > 0.5) // || !(position[1] > a[1] && position[1] > b[1]))
       {
-        for (PointMass *npm : vecs[0])
+        SteeringQuery query;
+        query.x = state.px[index];
+        query.y = state.py[index];
+        query.z = state.pz[index];
+        query.cohesion_r2 = fp->coherence * fp->coherence;
+        query.separation_r2 = fp->separation * fp->separation;
+        query.alignment_r2 = fp->alignment * fp->alignment;
+        query.self = index;
+        SteeringSums sums;
+        if (octree_mode)
         {
-          goal = goal + npm->position;
+          octree.accumulate(state, accumulate, query, octree_theta, sums);
         }
-        if (vecs[0].size() != 0)
+        else if (neighbour_list.valid())
         {
-          goal = goal / vecs[0].size();
+          accumulate(state.px.data(), state.py.data(), state.pz.data(),
+                     state.vx.data(), state.vy.data(), state.vz.data(),
+                     neighbour_list.neighbours(index), neighbour_list.numNeighbours(index), query, sums);
         }
-        point_mass.cumulatedSpeed += normalizeForce(goal - point_mass.position, point_mass) * cw;
-      }
-      goal = Vector3D();
-      for (PointMass *npm : vecs[1])
-      {
-        Vector3D sep = (point_mass.position - npm->position);
-        goal += sep;
-      }
-      if (vecs[1].size() != 0)
-      {
-        goal = goal / vecs[1].size();
-      }
-      point_mass.cumulatedSpeed += normalizeForce(goal, point_mass) * sw;
-      goal = Vector3D();
-      for (PointMass *npm : vecs[2])
-      {
-        goal = goal + npm->speed;
-      }
-      point_mass.cumulatedSpeed += normalizeForce(goal, point_mass) * aw;
+        else
+        {
+          neighbour_grid.queryRuns(position, [&](const int *indices, int count) {
+            accumulate(state.px.data(), state.py.data(), state.pz.data(),
+                       state.vx.data(), state.vy.data(), state.vz.data(),
+                       indices, count, query, sums);
+          });
+        }
+        Vector3D steering = state.steering(index);
+        Vector3D goal = Vector3D();
+        if (following)
+        {
+          double newCenterX = cursor.position.x * num - position.x;
+          double newCenterY = cursor.position.y * num - position.y;
+          double newCenterZ = cursor.position.z * num - position.z;
+          Vector3D newCenter = Vector3D(newCenterX, newCenterY, newCenterZ) / (num - 1);
+          Vector3D goal = (newCenter - position);
+          steering += normalizeForce(goal, species) * cw;
+        }
+        else
+        {
+          // the kernel sums offsets from this bird, so the centre is position + mean
+          if (sums.cohesion_count != 0)
+          {
+            goal = position + Vector3D(sums.cohesion[0], sums.cohesion[1], sums.cohesion[2]) / sums.cohesion_count;
+          }
+          steering += normalizeForce(goal - position, species) * cw;
+        }
+        goal = Vector3D();
+        if (sums.separation_count != 0)
+        {
+          goal = -Vector3D(sums.separation[0], sums.separation[1], sums.separation[2]) / sums.separation_count;
+        }
+        steering += normalizeForce(goal, species) * sw;
+        goal = Vector3D(sums.alignment[0], sums.alignment[1], sums.alignment[2]);
+        steering += normalizeForce(goal, species) * aw;
 
-    }
-  }
+        Vector3D decceleration = Vector3D(0, 0, 0);
 
-  for (PointMass &point_mass : point_masses)
-  {
-    // if "S" is not pressed or bird is not within 0.5 distance from bar, not affected by
-    // stopping behavior
-    vector<Vector3f> line = stopLine[point_mass.branch];
-    Vector3D a(line[0][0], line[0][1], line[0][2]);
-    Vector3D b(line[1][0], line[1][1], line[1][2]);
-    double dis = cylinder->computeDistance(point_mass.position, a, b);
-    if (!is_stopped || !point_mass.able_stop || dis > 0.5)//  || !(point_mass.position[1] > a[1] && point_mass.position[1] > b[1]))
-    {
-      /*Vector3D dir = point_mass.speed;
-        dir.normalize();
-        point_mass.speed = dir * max(min(point_mass.speed.norm(), point_mass.maxSpeed), -point_mass.maxSpeed);*/
-      Vector3D decceleration = Vector3D(0, 0, 0);
+        if (position.x > x || position.x < -x)
+        {
+          decceleration += (Vector3D(0.5, 0.5, 0.5) - position) * abs(position.x - x);
+        }
+        if (position.y > y || position.y < 0)
+        {
+          decceleration += (Vector3D(0.5, 0.5, 0.5) - position) * abs(position.y - y);
+        }
+        if (position.z > z || position.z < -z)
+        {
+          decceleration += (Vector3D(0.5, 0.5, 0.5) - position) * abs(position.z - z);
+        }
 
-      if (point_mass.position.x > x || point_mass.position.x < -x)
-      {
-        decceleration += (Vector3D(0.5, 0.5, 0.5) - point_mass.position) * abs(point_mass.position.x - x);
-      }
-      if (point_mass.position.y > y || point_mass.position.y < 0)
-      {
-        decceleration += (Vector3D(0.5, 0.5, 0.5) - point_mass.position) * abs(point_mass.position.y - y);
-      }
-      if (point_mass.position.z > z || point_mass.position.z < -z)
-      {
-        decceleration += (Vector3D(0.5, 0.5, 0.5) - point_mass.position) * abs(point_mass.position.z - z);
-      }
+        steering += (decceleration)*dw;
+
+        Vector3D accDir = steering;
+        accDir.normalize();
+        steering = accDir * CGL::clamp(steering.norm(), species.minAcc, species.maxAcc) * 0.00001;
 
-      point_mass.cumulatedSpeed += (decceleration)*dw;
+        Vector3D speed = state.speed(index) + steering;
 
-      Vector3D accDir = point_mass.cumulatedSpeed;
-      accDir.normalize();
-      point_mass.cumulatedSpeed = accDir * CGL::clamp(point_mass.cumulatedSpeed.norm(), point_mass.minAcc, point_mass.maxAcc) * 0.00001;
+        Vector3D dir = speed;
+        dir.normalize();
+        back.setSpeed(index, dir * CGL::clamp(speed.norm(), species.minSpeed, species.maxSpeed));
+        back.setPosition(index, position);
 
-      point_mass.speed += point_mass.cumulatedSpeed;
+        state.setSteering(index, Vector3D());
+        flying[index - block] = true;
+        perch_distance[index - block] = dis;
+      }
+      else {
+          flying[index - block] = false;
+          if (!cold.has_stop_pos)
+          {
+              // cut first and last 13% of the bar
+              double stop_frac = rng.uniform(.13, .87, bird, step_count, RANDOM_STOP_FRAC);
+              cold.rand_stop_pos = a + (b - a) * stop_frac;
+              cold.rand_stop_pos[1] += 0.02;
+              cold.has_stop_pos = true;
+          }
+
+          Vector3D speed = 0.00025 * (cold.rand_stop_pos - position);
+          back.setSpeed(index, speed);
+          back.setPosition(index, position + speed);
+          if (dis <= 0.02) {
+              change_state_random(cold, rng.uniform(bird, step_count, RANDOM_TOGGLE_STOP));
+          }
+      }
+    }
 
-      Vector3D dir = point_mass.speed;
-      dir.normalize();
-      point_mass.speed = dir * CGL::clamp(point_mass.speed.norm(), point_mass.minSpeed, point_mass.maxSpeed);
+    auto collision_start = chrono::steady_clock::now();
+    collided += collideFlying(back, block, block_end, flying, *collision_objects);
+    collision_seconds += secondsSince(collision_start);
 
-      point_mass.cumulatedSpeed = 0;
-      for (CollisionObject *collision_object : *collision_objects)
+    for (int index = block; index < block_end; index++)
+    {
+      if (!flying[index - block])
       {
-        collision_object->collide(point_mass);
+        continue;
       }
-      point_mass.position += point_mass.speed;
-      // std::cout << isnan(point_mass.position.x) << endl;
-      if (isnan(point_mass.position.x))
+      BirdColdState &cold = state.cold[index];
+      uint32_t bird = state.id[index];
+      double dis = perch_distance[index - block];
+      back.setPosition(index, back.position(index) + back.speed(index));
+      if (isnan(back.px[index]))
       {
-        point_mass = PointMass(Vector3D(rand() % 100 / 100., rand() % 100 / 100., rand() % 100 / 100.), false);
+        back.setPosition(index, generatePos(bird));
+        back.setSpeed(index, Vector3D(0.0001, 0, 0));
+        cold = BirdColdState();
+        cold.start_position = cold.last_position = back.position(index);
       }
 
       if (!is_stopped) {
-          point_mass.rand_stop_pos = NULL;
+          cold.has_stop_pos = false;
       }
       if (is_stopped && dis >= 1) {
-          change_state_random(point_mass);
-          
+          change_state_random(cold, rng.uniform(bird, step_count, RANDOM_TOGGLE_STOP));
       }
-
-
-    }
-    else {
-        if (point_mass.rand_stop_pos == NULL)
-        {
-            double x = (double)(rand() % 74) / 100. + .13; // cut first and last 13%
-            point_mass.rand_stop_pos = a + (b - a) * x;
-            point_mass.rand_stop_pos[1] += 0.02;
-        }
-
-        /* Vector3D dir = point_mass.rand_stop_pos - point_mass.position;
-         dir.normalize();
-         point_mass.speed = dir * CGL::clamp(point_mass.speed.norm(), point_mass.minSpeed, point_mass.maxSpeed);*/
-
-        point_mass.speed = 0.00025 * (point_mass.rand_stop_pos - point_mass.position);
-        point_mass.position += point_mass.speed;
-        if (dis <= 0.02) {
-            
-            change_state_random(point_mass);
-        }
     }
   }
+  neighbour_stats.steering_seconds += secondsSince(steering_start);
+  neighbour_stats.collision_seconds += collision_seconds;
+  neighbour_stats.collided += collided;
+
+  state.swapBuffers();
+  step_count++;
 }
 
 
@@ -327,66 +567,46 @@ Vector3D Flock::accelerationAgainstWall(double distance, Vector3D direction)
 
 void Flock::build_spatial_map()
 {
-  for (const auto &entry : map)
-  {
-    delete (entry.second);
-  }
-  map.clear();
-
-  // TODO (Part 4): Build a spatial map out of all of the point masses.
-  for (PointMass &point_mass : point_masses)
-  {
-    float hashed = hash_position(point_mass.position);
-    if (!map[hashed])
-    {
-      map[hashed] = new vector<PointMass *>();
-    }
-    map[hashed]->push_back(&point_mass);
-  }
+  spatial_map.build(state, spatial_cell_size());
 }
 
 void Flock::set_stop(bool is_stopped) {
-    for (PointMass& point_mass : point_masses)
+    for (BirdColdState& cold : state.cold)
     {
-        point_mass.able_stop = is_stopped;
+        cold.able_stop = is_stopped;
     }
 }
 
-void Flock::self_collide(PointMass &pm, double simulation_steps)
+void Flock::self_collide(int index, double simulation_steps)
 {
-  // TODO (Part 4): Handle self-collision for a given point mass.
-  float hashed = hash_position(pm.position);
+  Vector3D position = state.position(index);
   Vector3D temp;
   int i = 0;
-  if (map[hashed])
-  {
-    for (PointMass *point_mass : *map[hashed])
+  spatial_map.query(position, [&](int other) {
+    Vector3D dis = position - state.position(other);
+    if (other != index && dis.norm() <= 2 * thickness)
     {
-      Vector3D dis = pm.position - point_mass->position;
-      if (point_mass != &pm && dis.norm() <= 2 * thickness)
-      {
-        temp += (2 * thickness - dis.norm()) * dis.unit();
-        i += 1;
-      }
+      temp += (2 * thickness - dis.norm()) * dis.unit();
+      i += 1;
     }
-  }
+  });
   if (i)
   {
-    pm.position += temp / (i * simulation_steps);
+    state.setPosition(index, position + temp / (i * simulation_steps));
   }
 }
 
-float Flock::hash_position(Vector3D pos)
+Vector3D Flock::spatial_cell_size() const
+{
+  double w = 3 * width / num_width_points,
+         h = 3 * height / num_height_points,
+         t = max(w, h);
+  return Vector3D(w, h, t);
+}
+
+uint64_t Flock::hash_position(Vector3D pos)
 {
-  // TODO (Part 4): Hash a 3D position into a unique float identifier that represents membership in some 3D box volume.
-  float w = 3 * width / num_width_points,
-        h = 3 * height / num_height_points,
-        t = max(w, h);
-  float x = floor(pos[0] / w),
-        y = floor(pos[1] / h),
-        z = floor(pos[2] / t);
-  // return fmod(x + y * 31 + z * 31 * 31, num_width_points * num_height_points);// need mod?
-  return x + y * 233. + z * 233. * 233.; // need mod?
+  return SpatialHash::cellKey(pos, spatial_cell_size());
 }
 
 ///////////////////////////////////////////////////////
@@ -395,194 +615,21 @@ float Flock::hash_position(Vector3D pos)
 
 void Flock::follow()
 {
-  for (PointMass &p : point_masses)
+  for (int index = 0; index < (int)state.size(); index++)
   {
-    Vector3D dir = (cursor.position - p.position);
-    p.cumulatedSpeed = dir;
+    Vector3D dir = (cursor.position - state.position(index));
+    state.setSteering(index, dir);
   }
 }
 
 void Flock::reset()
 {
-  PointMass *pm = &point_masses[0];
-  for (int i = 0; i < point_masses.size(); i++)
-  {
-    pm->cumulatedSpeed = Vector3D();
-    initializeSpeed(pm);
-    pm->position = pm->start_position;
-    pm->last_position = pm->start_position;
-    pm++;
-  }
-}
-
-void Flock::buildFlockMesh()
-{
-  if (point_masses.size() == 0)
-    return;
-
-  FlockMesh *flockMesh = new FlockMesh();
-  vector<Triangle *> triangles;
-
-  // Create vector of triangles
-  for (int y = 0; y < num_height_points - 1; y++)
-  {
-    for (int x = 0; x < num_width_points - 1; x++)
-    {
-      PointMass *pm = &point_masses[y * num_width_points + x];
-      // Get neighboring point masses:
-      /*                      *
-       * pm_A -------- pm_B   *
-       *             /        *
-       *  |         /   |     *
-       *  |        /    |     *
-       *  |       /     |     *
-       *  |      /      |     *
-       *  |     /       |     *
-       *  |    /        |     *
-       *      /               *
-       * pm_C -------- pm_D   *
-       *                      *
-       */
-
-      float u_min = x;
-      u_min /= num_width_points - 1;
-      float u_max = x + 1;
-      u_max /= num_width_points - 1;
-      float v_min = y;
-      v_min /= num_height_points - 1;
-      float v_max = y + 1;
-      v_max /= num_height_points - 1;
-
-      PointMass *pm_A = pm;
-      PointMass *pm_B = pm + 1;
-      PointMass *pm_C = pm + num_width_points;
-      PointMass *pm_D = pm + num_width_points + 1;
-
-      Vector3D uv_A = Vector3D(u_min, v_min, 0);
-      Vector3D uv_B = Vector3D(u_max, v_min, 0);
-      Vector3D uv_C = Vector3D(u_min, v_max, 0);
-      Vector3D uv_D = Vector3D(u_max, v_max, 0);
-
-      // Both triangles defined by vertices in counter-clockwise orientation
-      triangles.push_back(new Triangle(pm_A, pm_C, pm_B,
-                                       uv_A, uv_C, uv_B));
-      triangles.push_back(new Triangle(pm_B, pm_C, pm_D,
-                                       uv_B, uv_C, uv_D));
-    }
-  }
-
-  // For each triangle in row-order, create 3 edges and 3 internal halfedges
-  for (int i = 0; i < triangles.size(); i++)
+  for (int index = 0; index < (int)state.size(); index++)
   {
-    Triangle *t = triangles[i];
-
-    // Allocate new halfedges on heap
-    Halfedge *h1 = new Halfedge();
-    Halfedge *h2 = new Halfedge();
-    Halfedge *h3 = new Halfedge();
-
-    // Allocate new edges on heap
-    Edge *e1 = new Edge();
-    Edge *e2 = new Edge();
-    Edge *e3 = new Edge();
-
-    // Assign a halfedge pointer to the triangle
-    t->halfedge = h1;
-
-    // Assign halfedge pointers to point masses
-    t->pm1->halfedge = h1;
-    t->pm2->halfedge = h2;
-    t->pm3->halfedge = h3;
-
-    // Update all halfedge pointers
-    h1->edge = e1;
-    h1->next = h2;
-    h1->pm = t->pm1;
-    h1->triangle = t;
-
-    h2->edge = e2;
-    h2->next = h3;
-    h2->pm = t->pm2;
-    h2->triangle = t;
-
-    h3->edge = e3;
-    h3->next = h1;
-    h3->pm = t->pm3;
-    h3->triangle = t;
+    BirdColdState &cold = state.cold[index];
+    state.setSteering(index, Vector3D());
+    state.setSpeed(index, initializeSpeed(state.speciesOf(index), rng, state.id[index], step_count));
+    state.setPosition(index, cold.start_position);
+    cold.last_position = cold.start_position;
   }
-
-  // Go back through the flock mesh and link triangles together using halfedge
-  // twin pointers
-
-  // Convenient variables for math
-  int num_height_tris = (num_height_points - 1) * 2;
-  int num_width_tris = (num_width_points - 1) * 2;
-
-  bool topLeft = true;
-  for (int i = 0; i < triangles.size(); i++)
-  {
-    Triangle *t = triangles[i];
-
-    if (topLeft)
-    {
-      // Get left triangle, if it exists
-      if (i % num_width_tris != 0)
-      { // Not a left-most triangle
-        Triangle *temp = triangles[i - 1];
-        t->pm1->halfedge->twin = temp->pm3->halfedge;
-      }
-      else
-      {
-        t->pm1->halfedge->twin = nullptr;
-      }
-
-      // Get triangle above, if it exists
-      if (i >= num_width_tris)
-      { // Not a top-most triangle
-        Triangle *temp = triangles[i - num_width_tris + 1];
-        t->pm3->halfedge->twin = temp->pm2->halfedge;
-      }
-      else
-      {
-        t->pm3->halfedge->twin = nullptr;
-      }
-
-      // Get triangle to bottom right; guaranteed to exist
-      Triangle *temp = triangles[i + 1];
-      t->pm2->halfedge->twin = temp->pm1->halfedge;
-    }
-    else
-    {
-      // Get right triangle, if it exists
-      if (i % num_width_tris != num_width_tris - 1)
-      { // Not a right-most triangle
-        Triangle *temp = triangles[i + 1];
-        t->pm3->halfedge->twin = temp->pm1->halfedge;
-      }
-      else
-      {
-        t->pm3->halfedge->twin = nullptr;
-      }
-
-      // Get triangle below, if it exists
-      if (i + num_width_tris - 1 < 1.0f * num_width_tris * num_height_tris / 2.0f)
-      { // Not a bottom-most triangle
-        Triangle *temp = triangles[i + num_width_tris - 1];
-        t->pm2->halfedge->twin = temp->pm3->halfedge;
-      }
-      else
-      {
-        t->pm2->halfedge->twin = nullptr;
-      }
-
-      // Get triangle to top left; guaranteed to exist
-      Triangle *temp = triangles[i - 1];
-      t->pm1->halfedge->twin = temp->pm2->halfedge;
-    }
-
-    topLeft = !topLeft;
-  }
-
-  flockMesh->triangles = triangles;
-  this->flockMesh = flockMesh;
 }
@@ -9,7 +9,13 @@
 #include "CGL/CGL.h"
 #include "CGL/misc.h"
 #include "flockMesh.h"
+#include "flockRandom.h"
+#include "flockState.h"
 #include "collision/collisionObject.h"
+#include "neighbourList.h"
+#include "octree.h"
+#include "spatialGrid.h"
+#include "spatialHash.h"
 #include "spring.h"
 
 using namespace CGL;
@@ -45,23 +51,42 @@ struct Flock {
   ~Flock();
 
   void buildGrid();
+  // Adds `count` birds at random positions, or removes the `count` birds
+  // added last. Both take time proportional to count, not to the flock.
+  void spawn_birds(size_t count);
+  void despawn_birds(size_t count);
 
   void simulate(double frames_per_sec, double simulation_steps, FlockParameters *fp,
-                vector<Vector3D> external_accelerations,
+                const vector<Vector3D> &external_accelerations,
                 vector<CollisionObject *> *collision_objects, Vector3D windDir, bool is_stopped);
-  vector<PointMass> getNeighbours(PointMass pm, double range);
-  vector<vector<PointMass*>> getNeighbours(PointMass pm, vector<double> range);
+  // Indices of the neighbours of bird `index` within each of the given
+  // ranges. The grid version needs build_neighbour_grid() to be up to date;
+  // the brute force version scans the whole flock and is kept as a reference.
+  vector<vector<int>> getNeighbours(int index, const vector<double> &range);
+  vector<vector<int>> getNeighboursBruteForce(int index, const vector<double> &range);
+  void build_neighbour_grid(double cell_size);
+  // Brings neighbour_list (or, without lists, neighbour_grid) up to date for
+  // the given radius.
+  void update_neighbours(double radius);
+  // Sorts the birds along a Morton curve so that birds close in space are
+  // close in memory. Their ids stay the same.
+  void reorder_birds();
   void reset();
-  void buildFlockMesh();
 
+  // Pushes bird index out of the birds within 2 * thickness of it, found in
+  // spatial_map, which build_spatial_map fills. simulate() calls neither:
+  // self-collision is off, as it always was.
   void build_spatial_map();
-  void self_collide(PointMass &pm, double simulation_steps);
-  float hash_position(Vector3D pos);
+  void self_collide(int index, double simulation_steps);
+  // Key of the self_collide cell of pos in spatial_map.
+  uint64_t hash_position(Vector3D pos);
+  Vector3D spatial_cell_size() const;
 
 
   Vector3D accelerationAgainstWall(double distance, Vector3D direction);
   void follow();
-  Vector3D generatePos();
+  // Uniform spawn position of the given bird in the current step.
+  Vector3D generatePos(size_t bird) const;
   void set_stop(bool is_stopped);
 
   // flock properties
@@ -74,11 +99,10 @@ struct Flock {
   bool following = false;
 
   // flock components
-  vector<PointMass> point_masses;
-  vector<Bird> birds;
+  FlockState state;
+  vector<Bird> birds; // by id
   vector<vector<int>> pinned;
   vector<Spring> springs;
-  FlockMesh *flockMesh;
   PointMass cursor = PointMass(Vector3D(0.5, 0.5, 0.5), false);
 
   //flock parameter weights
@@ -87,7 +111,40 @@ struct Flock {
   double separation_weight = 1.0;
 
   // Spatial hashing
-  unordered_map<float, vector<PointMass *> *> map;
+  SpatialHash spatial_map;
+  SpatialGrid neighbour_grid;
+  NeighbourList neighbour_list;
+  // Verlet skin of neighbour_list; 0 queries the grid every step instead.
+  double neighbour_skin = 0.05;
+  // Keep neighbour_grid between builds and only move the birds that changed
+  // cell, see SpatialGrid::update.
+  bool incremental_grid = false;
+  NeighbourStats neighbour_stats;
+  // Barnes-Hut mode for ranges that span the flock: cohesion and alignment
+  // read far nodes of the octree, rebuilt every step, instead of the birds.
+  bool octree_mode = false;
+  double octree_theta = 0.5;
+  Octree octree;
+
+  // How often reorder_birds() runs: every reorder_interval steps, never, or
+  // (adaptive) whenever the neighbour lists are rebuilt anyway. Without
+  // lists, adaptive reorders every ADAPTIVE_REORDER_STEPS steps.
+  static const int REORDER_NEVER = -1;
+  static const int REORDER_ADAPTIVE = 0;
+  static const int ADAPTIVE_REORDER_STEPS = 64;
+  int reorder_interval = REORDER_ADAPTIVE;
+  // simulate() steers this many birds before it passes them through the
+  // collision objects together
+  static const int COLLISION_BLOCK = 64;
+  vector<uint64_t> morton_keys;
+  vector<int> morton_order;
+  // scratch of spawn_birds
+  vector<float> spawn_x, spawn_y, spawn_z;
+
+  // Every random draw of the simulation, keyed by bird id and step_count.
+  FlockRandom rng;
+  uint64_t step_count = 0;
+
   double x = 5;
   double y = 5;
   double z = 5;
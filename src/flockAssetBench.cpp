@@ -0,0 +1,291 @@
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include "misc/getopt.h" // getopt for windows
+#else
+#include <getopt.h>
+#endif
+
+#include "flockRandom.h"
+#include "imageLoader.h"
+#include "misc/file_utils.h"
+#include "objLoader.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "misc/stb_image_write.h"
+
+using namespace std;
+
+// Times the viewer's asset loading without a window: the OBJ models and the
+// textures as the viewer reads them at startup, from a directory or
+// generated here.
+
+void usageError(const char* binaryName) {
+    printf("Usage: %s [options]\n", binaryName);
+    printf("Program options:\n");
+    printf("  --meshes <DIR>     Time loading every .obj file in DIR, parsed and from the\n");
+    printf("                     .meshbin cache.\n");
+    printf("  --synthetic-mesh <INT>\n");
+    printf("                     Time loading a generated OBJ of this many triangles the\n");
+    printf("                     same way.\n");
+    printf("  --textures <DIR>   Time decoding every .png and .jpg file in DIR, one after\n");
+    printf("                     another and on the viewer's decoding threads.\n");
+    printf("  --synthetic-cubemap <INT>\n");
+    printf("                     Time decoding six generated PNG cube faces of this many\n");
+    printf("                     pixels a side the same way.\n");
+    printf("\n");
+    exit(-1);
+}
+
+// Where generated files go while they are timed.
+string tempDirectory() {
+    const char* temp_dir = getenv("TMPDIR");
+    temp_dir = temp_dir ? temp_dir : getenv("TEMP");
+    return temp_dir ? temp_dir : "/tmp";
+}
+
+// Times loading an OBJ file both ways: mapping and parsing it, and reading
+// the .meshbin cache that the first load writes next to it.
+bool reportMesh(const string& path) {
+    auto start = chrono::steady_clock::now();
+    FileUtils::MappedFile file;
+    IndexedMesh parsed;
+    string error;
+    if (!file.open(path)) {
+        cout << "Error: cannot open " << path << endl;
+        return false;
+    }
+    if (!parseOBJ(file.data(), file.size(), parsed, error)) {
+        cout << "Error: " << path << ", " << error << endl;
+        return false;
+    }
+    double parse_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    IndexedMesh cached;
+    bool from_cache = false;
+    if (!loadMesh(path, cached)) {
+        return false;
+    }
+    start = chrono::steady_clock::now();
+    loadMesh(path, cached, &from_cache);
+    double cache_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    bool same = cached.positions == parsed.positions && cached.uvs == parsed.uvs &&
+                cached.normals == parsed.normals && cached.indices == parsed.indices;
+
+    printf("Mesh:    %s, %.1f KB\n", path.c_str(), file.size() / 1024.);
+    printf("         %zu triangles, %zu vertices for their %zu corners\n", parsed.numTriangles(),
+           parsed.numVertices(), parsed.indices.size());
+    printf("         parsed in %.3f ms (%.0f MB/s), ", parse_seconds * 1e3, file.size() / parse_seconds / 1e6);
+    if (from_cache) {
+        printf("from the cache in %.3f ms (%.1fx), %s\n", cache_seconds * 1e3, parse_seconds / cache_seconds,
+               same ? "same mesh" : "DIFFERENT mesh");
+    } else {
+        printf("cache not written\n");
+    }
+    return same;
+}
+
+// A rows x cols grid of quads on a bumpy surface, each quad two triangles,
+// with positions, uvs and normals shared between the quads like an
+// exporter writes them.
+bool writeSyntheticOBJ(const string& path, int num_triangles) {
+    int cols = max((int)ceil(sqrt(num_triangles / 2.)), 1);
+    int rows = max((num_triangles / 2 + cols - 1) / cols, 1);
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        cout << "Error: cannot write " << path << endl;
+        return false;
+    }
+    fprintf(file, "# %d x %d grid, %d triangles\n", cols, rows, 2 * rows * cols);
+    for (int r = 0; r <= rows; r++) {
+        for (int c = 0; c <= cols; c++) {
+            double x = (double)c / cols, y = (double)r / rows;
+            double height = 0.05 * sin(20 * x) * cos(20 * y);
+            fprintf(file, "v %.6f %.6f %.6f\n", x, height, y);
+        }
+    }
+    for (int r = 0; r <= rows; r++) {
+        for (int c = 0; c <= cols; c++) {
+            fprintf(file, "vt %.6f %.6f\n", (double)c / cols, (double)r / rows);
+        }
+    }
+    for (int r = 0; r <= rows; r++) {
+        for (int c = 0; c <= cols; c++) {
+            double x = (double)c / cols, y = (double)r / rows;
+            double nx = -cos(20 * x) * cos(20 * y), nz = sin(20 * x) * sin(20 * y);
+            double norm = sqrt(nx * nx + 1 + nz * nz);
+            fprintf(file, "vn %.6f %.6f %.6f\n", nx / norm, 1 / norm, nz / norm);
+        }
+    }
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            int a = r * (cols + 1) + c + 1, b = a + 1, d = a + cols + 1, e = d + 1;
+            fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, e, e, e);
+            fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, e, e, e, d, d, d);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+// Decodes the images one after another, then with the ImageLoader the
+// viewer starts at launch, which also says when the first one was ready to
+// upload.
+bool reportDecode(const string& what, const vector<string>& paths) {
+    auto start = chrono::steady_clock::now();
+    size_t bytes = 0;
+    for (const string& path : paths) {
+        RGBImage image;
+        if (!image.load(path)) {
+            cout << "Error: cannot decode " << path << endl;
+            return false;
+        }
+        bytes += (size_t)image.width * image.height * 3;
+    }
+    double serial_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    ImageLoader loader(paths);
+    unique_ptr<RGBImage> image;
+    size_t index;
+    double first_seconds = 0;
+    bool ok = true;
+    while (loader.next(image, index)) {
+        if (first_seconds == 0) {
+            first_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+        ok = image->pixels && ok;
+    }
+    double pool_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printf("Images:  %s, %zu files, %.1f MB decoded\n", what.c_str(), paths.size(), bytes / 1e6);
+    printf("         one after another %.3f ms (%.0f MB/s), on %d threads %.3f ms (%.2fx),\n",
+           serial_seconds * 1e3, bytes / serial_seconds / 1e6, loader.numThreads(), pool_seconds * 1e3,
+           serial_seconds / pool_seconds);
+    printf("         first ready after %.3f ms\n", first_seconds * 1e3);
+    return ok;
+}
+
+// A cube face of sky: a gradient towards the horizon, soft clouds of
+// summed sines and a little per-pixel noise, so that it compresses about
+// like a photo rather than a flat colour.
+bool writeSyntheticFace(const string& path, int size, int face) {
+    vector<unsigned char> pixels((size_t)size * size * 3);
+    FlockRandom rng(face + 1);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            double u = (double)x / size, v = (double)y / size;
+            double cloud = 0.5 + 0.25 * sin(9 * u + face) * cos(7 * v) + 0.25 * sin(31 * u * v + 3 * face);
+            double noise = rng.uniform(-6, 6, (uint64_t)y * size + x, 0, 0);
+            unsigned char* pixel = &pixels[((size_t)y * size + x) * 3];
+            pixel[0] = (unsigned char)max(0., min(255., 90 + 120 * cloud * v + noise));
+            pixel[1] = (unsigned char)max(0., min(255., 140 + 90 * cloud * v + noise));
+            pixel[2] = (unsigned char)max(0., min(255., 220 + 30 * cloud + noise));
+        }
+    }
+    if (!stbi_write_png(path.c_str(), size, size, 3, pixels.data(), size * 3)) {
+        cout << "Error: cannot write " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    string mesh_dir;
+    int synthetic_triangles = 0;
+    string texture_dir;
+    int synthetic_face_size = 0;
+
+    enum { OPT_MESHES = 256, OPT_SYNTHETIC_MESH, OPT_TEXTURES, OPT_SYNTHETIC_CUBEMAP };
+    const struct option long_options[] = {
+        {"meshes", required_argument, NULL, OPT_MESHES},
+        {"synthetic-mesh", required_argument, NULL, OPT_SYNTHETIC_MESH},
+        {"textures", required_argument, NULL, OPT_TEXTURES},
+        {"synthetic-cubemap", required_argument, NULL, OPT_SYNTHETIC_CUBEMAP},
+        {NULL, 0, NULL, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch (c) {
+        case OPT_MESHES: {
+            mesh_dir = optarg;
+            break;
+        }
+        case OPT_SYNTHETIC_MESH: {
+            synthetic_triangles = max(atoi(optarg), 2);
+            break;
+        }
+        case OPT_TEXTURES: {
+            texture_dir = optarg;
+            break;
+        }
+        case OPT_SYNTHETIC_CUBEMAP: {
+            synthetic_face_size = max(atoi(optarg), 1);
+            break;
+        }
+        default: {
+            usageError(argv[0]);
+            break;
+        }
+        }
+    }
+    if (mesh_dir.empty() && synthetic_triangles == 0 && texture_dir.empty() && synthetic_face_size == 0) {
+        usageError(argv[0]);
+    }
+
+    bool ok = true;
+    if (!mesh_dir.empty()) {
+        set<string> files;
+        if (!FileUtils::list_files_in_directory(mesh_dir, files)) {
+            cout << "Error: cannot list " << mesh_dir << endl;
+            return -1;
+        }
+        for (const string& name : files) {
+            string before_extension, extension;
+            if (FileUtils::split_filename(name, before_extension, extension) && extension == "obj") {
+                ok = reportMesh(mesh_dir + "/" + name) && ok;
+            }
+        }
+    }
+    if (synthetic_triangles > 0) {
+        string path = tempDirectory() + "/flock_synthetic_" + to_string(synthetic_triangles) + ".obj";
+        ok = writeSyntheticOBJ(path, synthetic_triangles) && reportMesh(path) && ok;
+        remove(path.c_str());
+        remove((path + ".meshbin").c_str());
+    }
+    if (!texture_dir.empty()) {
+        set<string> files;
+        if (!FileUtils::list_files_in_directory(texture_dir, files)) {
+            cout << "Error: cannot list " << texture_dir << endl;
+            return -1;
+        }
+        vector<string> paths;
+        for (const string& name : files) {
+            string before_extension, extension;
+            if (FileUtils::split_filename(name, before_extension, extension) &&
+                (extension == "png" || extension == "jpg" || extension == "jpeg")) {
+                paths.push_back(texture_dir + "/" + name);
+            }
+        }
+        if (!paths.empty()) {
+            ok = reportDecode(texture_dir, paths) && ok;
+        }
+    }
+    if (synthetic_face_size > 0) {
+        vector<string> faces;
+        bool written = true;
+        for (int face = 0; face < 6 && written; face++) {
+            faces.push_back(tempDirectory() + "/flock_face_" + to_string(face) + "_" +
+                            to_string(synthetic_face_size) + ".png");
+            written = writeSyntheticFace(faces.back(), synthetic_face_size, face);
+        }
+        string what = "cube faces of " + to_string(synthetic_face_size) + "x" + to_string(synthetic_face_size);
+        ok = written && reportDecode(what, faces) && ok;
+        for (const string& face : faces) {
+            remove(face.c_str());
+        }
+    }
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,223 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "misc/file_utils.h"
+#include "misc/stb_image.h"
+#include "objLoader.h"
+
+using namespace std;
+
+// Bakes files of the project root into a C++ source for the viewer (see
+// misc/embedded_resources.h), run by the build: OBJ meshes become indexed
+// vertex arrays, PNG and JPEG images RGB pixels, anything else text.
+//
+// With --incbin the pixels go into .rgb files next to the source, which the
+// assembler pulls in with .incbin (GCC and Clang); without, they are written
+// out as arrays, which any compiler takes but slowly.
+
+void usageError(const char* binaryName) {
+    printf("Usage: %s [--incbin] <project root> <output .cpp> <path under the root>...\n", binaryName);
+    exit(-1);
+}
+
+struct Output {
+    FILE* file;
+    string dir; // of the .cpp, where the .rgb files go
+    bool incbin;
+    vector<string> texts, images, meshes; // table rows
+};
+
+string quoted(const string& s) {
+    string result = "\"";
+    for (char c : s) {
+        if (c == '\\' || c == '"') {
+            result += '\\';
+            result += c;
+        } else if (c == '\n') {
+            result += "\\n";
+        } else if (c == '\t') {
+            result += "\\t";
+        } else if ((unsigned char)c < 32 || (unsigned char)c >= 127) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\%03o", (unsigned char)c);
+            result += escape;
+        } else {
+            result += c;
+        }
+    }
+    return result + "\"";
+}
+
+// Shortest text that reads back as the same float.
+string floatLiteral(float value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.9g", value);
+    string literal = text;
+    if (literal.find_first_of(".e") == string::npos) {
+        literal += ".0";
+    }
+    return literal + "f";
+}
+
+bool bakeText(Output& out, const string& root, const string& path) {
+    FileUtils::MappedFile file;
+    if (!file.open(root + "/" + path)) {
+        cout << "Error: cannot open " << root << "/" << path << endl;
+        return false;
+    }
+    string name = "text_" + to_string(out.texts.size());
+    fprintf(out.file, "const char %s[] =", name.c_str());
+    // a literal per line, keeping each one short
+    size_t line_start = 0;
+    for (size_t i = 0; i < file.size(); i++) {
+        if (file.data()[i] == '\n' || i + 1 == file.size()) {
+            fprintf(out.file, "\n    %s", quoted(string(file.data() + line_start, i + 1 - line_start)).c_str());
+            line_start = i + 1;
+        }
+    }
+    fprintf(out.file, "%s;\n\n", file.size() ? "" : " \"\"");
+    out.texts.push_back("{" + quoted(path) + ", " + name + ", sizeof(" + name + ") - 1}");
+    return true;
+}
+
+bool bakeImage(Output& out, const string& root, const string& path) {
+    int width, height, channels;
+    unsigned char* pixels = stbi_load((root + "/" + path).c_str(), &width, &height, &channels, 3);
+    if (!pixels) {
+        cout << "Error: cannot decode " << root << "/" << path << ": " << stbi_failure_reason() << endl;
+        return false;
+    }
+    size_t size = (size_t)width * height * 3;
+    string name = "flock_image_" + to_string(out.images.size());
+    if (out.incbin) {
+        string blob = out.dir + "/" + name + ".rgb";
+        FILE* file = fopen(blob.c_str(), "wb");
+        bool written = file && fwrite(pixels, 1, size, file) == size;
+        written = file && fclose(file) == 0 && written;
+        if (!written) {
+            cout << "Error: cannot write " << blob << endl;
+            stbi_image_free(pixels);
+            return false;
+        }
+        fprintf(out.file, "extern \"C\" const unsigned char %s[];\n", name.c_str());
+        fprintf(out.file, "__asm__(FLOCK_BAKE_SECTION \"\\n\"\n");
+        fprintf(out.file, "        \".balign 16\\n\"\n");
+        fprintf(out.file, "        \".globl \" FLOCK_BAKE_SYMBOL(\"%s\") \"\\n\"\n", name.c_str());
+        fprintf(out.file, "        FLOCK_BAKE_SYMBOL(\"%s\") \":\\n\"\n", name.c_str());
+        fprintf(out.file, "        %s\n", quoted(".incbin " + quoted(blob) + "\n").c_str());
+        fprintf(out.file, "        \".text\\n\");\n\n");
+    } else {
+        fprintf(out.file, "alignas(16) const unsigned char %s[] = {", name.c_str());
+        for (size_t i = 0; i < size; i++) {
+            fprintf(out.file, i % 24 ? "%d," : "\n    %d,", pixels[i]);
+        }
+        fprintf(out.file, "\n};\n\n");
+    }
+    stbi_image_free(pixels);
+    out.images.push_back("{" + quoted(path) + ", " + to_string(width) + ", " + to_string(height) + ", " +
+                         to_string(channels) + ", " + name + "}");
+    return true;
+}
+
+bool bakeMesh(Output& out, const string& root, const string& path) {
+    IndexedMesh mesh;
+    FileUtils::MappedFile file;
+    string error;
+    if (!file.open(root + "/" + path)) {
+        cout << "Error: cannot open " << root << "/" << path << endl;
+        return false;
+    }
+    if (!parseOBJ(file.data(), file.size(), mesh, error)) {
+        cout << "Error: " << root << "/" << path << ", " << error << endl;
+        return false;
+    }
+    string name = "mesh_" + to_string(out.meshes.size());
+    vector<float> vertices = mesh.interleaved();
+    fprintf(out.file, "constexpr float %s_vertices[] = {", name.c_str());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        fprintf(out.file, i % 8 ? " %s," : "\n    %s,", floatLiteral(vertices[i]).c_str());
+    }
+    fprintf(out.file, "\n};\n\nconstexpr uint32_t %s_indices[] = {", name.c_str());
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        fprintf(out.file, i % 12 ? " %u," : "\n    %u,", mesh.indices[i]);
+    }
+    fprintf(out.file, "\n};\n\n");
+    out.meshes.push_back("{" + quoted(path) + ", " + name + "_vertices, " + to_string(mesh.numVertices()) + ", " +
+                         name + "_indices, " + to_string(mesh.indices.size()) + "}");
+    return true;
+}
+
+void writeTable(Output& out, const char* type, const char* name, const vector<string>& rows) {
+    if (rows.empty()) {
+        return;
+    }
+    fprintf(out.file, "const %s %s[] = {\n", type, name);
+    for (const string& row : rows) {
+        fprintf(out.file, "    %s,\n", row.c_str());
+    }
+    fprintf(out.file, "};\n\n");
+}
+
+int main(int argc, char** argv) {
+    Output out;
+    out.incbin = argc > 1 && strcmp(argv[1], "--incbin") == 0;
+    int first = out.incbin ? 2 : 1;
+    if (argc < first + 2) {
+        usageError(argv[0]);
+    }
+    string root = argv[first], output = argv[first + 1];
+    size_t slash = output.find_last_of("/\\");
+    out.dir = slash == string::npos ? "." : output.substr(0, slash);
+
+    string temp_output = output + ".tmp";
+    out.file = fopen(temp_output.c_str(), "w");
+    if (!out.file) {
+        cout << "Error: cannot write " << temp_output << endl;
+        return -1;
+    }
+    fprintf(out.file, "// Generated by flock_bake from %s, do not edit.\n\n", root.c_str());
+    fprintf(out.file, "#include <cstdint>\n\n#include \"misc/embedded_resources.h\"\n\n");
+    if (out.incbin) {
+        fprintf(out.file, "#ifdef __APPLE__\n#define FLOCK_BAKE_SECTION \".const_data\"\n");
+        fprintf(out.file, "#define FLOCK_BAKE_SYMBOL(name) \"_\" name\n#else\n");
+        fprintf(out.file, "#define FLOCK_BAKE_SECTION \".section .rodata\"\n");
+        fprintf(out.file, "#define FLOCK_BAKE_SYMBOL(name) name\n#endif\n\n");
+    }
+    fprintf(out.file, "namespace EmbeddedResources {\n\nnamespace {\n\n");
+
+    bool ok = true;
+    for (int i = first + 2; i < argc && ok; i++) {
+        string path = argv[i], before_extension, extension;
+        FileUtils::split_filename(path, before_extension, extension);
+        if (extension == "obj") {
+            ok = bakeMesh(out, root, path);
+        } else if (extension == "png" || extension == "jpg" || extension == "jpeg") {
+            ok = bakeImage(out, root, path);
+        } else {
+            ok = bakeText(out, root, path);
+        }
+    }
+
+    writeTable(out, "Text", "texts", out.texts);
+    writeTable(out, "Image", "images", out.images);
+    writeTable(out, "Mesh", "meshes", out.meshes);
+    fprintf(out.file, "} // namespace\n\nconst Tables tables = {\n");
+    fprintf(out.file, "    %s, %zu,\n", out.texts.empty() ? "nullptr" : "texts", out.texts.size());
+    fprintf(out.file, "    %s, %zu,\n", out.images.empty() ? "nullptr" : "images", out.images.size());
+    fprintf(out.file, "    %s, %zu,\n", out.meshes.empty() ? "nullptr" : "meshes", out.meshes.size());
+    fprintf(out.file, "};\n\n} // namespace EmbeddedResources\n");
+    ok = fclose(out.file) == 0 && ok;
+
+#ifdef _WIN32
+    remove(output.c_str());
+#endif
+    if (!ok || rename(temp_output.c_str(), output.c_str()) != 0) {
+        remove(temp_output.c_str());
+        return -1;
+    }
+    return 0;
+}
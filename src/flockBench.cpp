@@ -0,0 +1,75 @@
+#include "flockBench.h"
+
+#include <iostream>
+#include <stdlib.h>
+
+#include "collision/cylinder.h"
+#include "misc/file_utils.h"
+#include "sceneLoader.h"
+
+using namespace std;
+
+bool find_default_scene(string& retval) {
+    const char* search_paths[] = {".", "..", "../..", "../../.."};
+    for (const char* search_path : search_paths) {
+        string scene = string(search_path) + "/scene/env.json";
+        if (FileUtils::file_exists(scene)) {
+            retval = scene;
+            return true;
+        }
+    }
+    return false;
+}
+
+string tempDirectory() {
+    const char* temp_dir = getenv("TMPDIR");
+    temp_dir = temp_dir ? temp_dir : getenv("TEMP");
+    return temp_dir ? temp_dir : "/tmp";
+}
+
+HeadlessScene::~HeadlessScene() {
+    for (CollisionObject* object : objects) {
+        delete object;
+    }
+}
+
+bool HeadlessScene::load(const string& scene, const FlockParameters& params, uint64_t seed) {
+    flock.rng.seed = seed;
+    fp = params;
+    if (!loadObjectsFromFile(scene, &flock, &fp, &objects, 1, 1)) {
+        cout << "Error: Unable to load from file: " << scene << endl;
+        return false;
+    }
+    if (objects.empty() || !dynamic_cast<Cylinder*>(objects[0])) {
+        cout << "Error: Scene needs \"cylinders\" as its first collision object: " << scene << endl;
+        return false;
+    }
+    flock.num_birds = fp.num_birds;
+    return true;
+}
+
+void HeadlessScene::replacePerches(CollisionObject* perches) {
+    delete objects[0];
+    objects[0] = perches;
+}
+
+void HeadlessScene::step(bool is_stopped) {
+    flock.simulate(90, 30, &fp, external_accelerations, &objects, wind, is_stopped);
+}
+
+FlockCopy::FlockCopy(const FlockState& state) : cold(state.cold) {
+    kinematics.px = state.px;
+    kinematics.py = state.py;
+    kinematics.pz = state.pz;
+    kinematics.vx = state.vx;
+    kinematics.vy = state.vy;
+    kinematics.vz = state.vz;
+    span = {kinematics.px.data(), kinematics.py.data(), kinematics.pz.data(), kinematics.vx.data(),
+            kinematics.vy.data(), kinematics.vz.data(), cold.data(), state.size()};
+}
+
+bool FlockCopy::sameBirds(const FlockCopy& other) const {
+    return kinematics.px == other.kinematics.px && kinematics.py == other.kinematics.py &&
+           kinematics.pz == other.kinematics.pz && kinematics.vx == other.kinematics.vx &&
+           kinematics.vy == other.kinematics.vy && kinematics.vz == other.kinematics.vz;
+}
@@ -0,0 +1,57 @@
+#ifndef FLOCK_BENCH_H
+#define FLOCK_BENCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "collision/collisionObject.h"
+#include "flock.h"
+
+// Pieces shared by the programs that run the flock without a window:
+// flock_headless, flock_check and the benchmarks.
+
+// Same search as the viewer, but looking for the default scene.
+bool find_default_scene(std::string& retval);
+
+// Where generated files go while they are used.
+std::string tempDirectory();
+
+// A flock loaded from a scene file, with the collision objects it owns.
+// Flock::simulate takes its perches from the first collision object, so the
+// scene must start with its "cylinders".
+struct HeadlessScene {
+    HeadlessScene() {}
+    ~HeadlessScene();
+    HeadlessScene(const HeadlessScene&) = delete;
+    HeadlessScene& operator=(const HeadlessScene&) = delete;
+
+    // Prints why on failure. Leaves the birds to the caller, who sets the
+    // flock's options first and then calls buildGrid() or loadCheckpoint().
+    bool load(const std::string& scene, const FlockParameters& params, uint64_t seed);
+    // Replaces the first collision object.
+    void replacePerches(CollisionObject* perches);
+    // One substep, as FlockSimulator::drawContents takes them.
+    void step(bool is_stopped);
+
+    Flock flock;
+    FlockParameters fp;
+    std::vector<CollisionObject*> objects;
+    std::vector<Vector3D> external_accelerations = {Vector3D(0, -9.8, 0)};
+    Vector3D wind = Vector3D(1, 0, 0);
+};
+
+// Positions, speeds and cold state of a flock, for timed passes that must
+// leave the flock itself alone.
+struct FlockCopy {
+    FlockCopy(const FlockState& state);
+    FlockCopy(const FlockCopy&) = delete;
+
+    bool sameBirds(const FlockCopy& other) const;
+
+    FlockKinematics kinematics;
+    std::vector<BirdColdState> cold;
+    BirdSpan span;
+};
+
+#endif /* FLOCK_BENCH_H */
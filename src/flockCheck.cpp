@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include "misc/getopt.h" // getopt for windows
+#else
+#include <getopt.h>
+#endif
+
+#include "flockBench.h"
+#include "flockCheckpoint.h"
+#include "flockRandom.h"
+
+using namespace std;
+
+// Checks of the simulation that need no window, each failing the run when
+// the flock does not behave as it should. Without options every check runs.
+
+void usageError(const char* binaryName) {
+    printf("Usage: %s [options]\n", binaryName);
+    printf("Program options:\n");
+    printf("  -f     <STRING>    Filename of scene.\n");
+    printf("                     Defaults to scene/env.json under the project root.\n");
+    printf("  -n     <INT>       Number of birds.\n");
+    printf("  -s     <INT>       Number of simulation steps of each check.\n");
+    printf("  -r     <FLOAT>     Coherence, alignment and separation range of the neighbour\n");
+    printf("                     check. Defaults to the viewer's ranges on -n birds and\n");
+    printf("                     ranges of 0.02 to 0.1 on twice as many.\n");
+    printf("  --seed <INT>       Seed of the simulation's random numbers. Defaults to 0.\n");
+    printf("  --neighbours       Compare the neighbour grid's neighbours of every bird with a\n");
+    printf("                     scan of the whole flock after each step, with the grid\n");
+    printf("                     rebuilt and updated in place, for the flock as it spawns\n");
+    printf("                     and scattered past the unit cube.\n");
+    printf("  --checkpoint       Save a flock, step it on, restore the save into a new flock\n");
+    printf("                     and step that as far: both must end the same, byte for byte.\n");
+    printf("\n");
+    exit(-1);
+}
+
+struct CheckOptions {
+    string scene;
+    FlockParameters fp;
+    int num_steps;
+    uint64_t seed;
+};
+
+template <typename T>
+bool sameBytes(const T& a, const T& b) {
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0;
+}
+
+bool sameBytes(const Vector3D& a, const Vector3D& b) {
+    return memcmp(&a.x, &b.x, sizeof(double)) == 0 && memcmp(&a.y, &b.y, sizeof(double)) == 0 &&
+           memcmp(&a.z, &b.z, sizeof(double)) == 0;
+}
+
+// Compares everything a checkpoint holds. BirdColdState goes field by field,
+// its padding is not part of the state.
+bool sameFlock(const Flock& a, const Flock& b) {
+    const FlockState &sa = a.state, &sb = b.state;
+    if (a.step_count != b.step_count || a.rng.seed != b.rng.seed || !sameBytes(sa.px, sb.px) ||
+        !sameBytes(sa.py, sb.py) || !sameBytes(sa.pz, sb.pz) || !sameBytes(sa.vx, sb.vx) ||
+        !sameBytes(sa.vy, sb.vy) || !sameBytes(sa.vz, sb.vz) || !sameBytes(sa.ax, sb.ax) ||
+        !sameBytes(sa.ay, sb.ay) || !sameBytes(sa.az, sb.az) || !sameBytes(sa.id, sb.id) ||
+        !sameBytes(sa.index_of, sb.index_of) || !sameBytes(sa.generation, sb.generation) ||
+        !sameBytes(sa.species_id, sb.species_id) || sa.cold.size() != sb.cold.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < sa.cold.size(); i++) {
+        const BirdColdState &ca = sa.cold[i], &cb = sb.cold[i];
+        if (!sameBytes(ca.start_position, cb.start_position) || !sameBytes(ca.last_position, cb.last_position) ||
+            !sameBytes(ca.rand_stop_pos, cb.rand_stop_pos) || ca.has_stop_pos != cb.has_stop_pos ||
+            ca.able_stop != cb.able_stop || ca.branch != cb.branch || ca.timer != cb.timer) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// One flock the neighbour check runs on. Small ranges spread the flock
+// over many cells, so the grid leaves most birds out of each query; a
+// scattered flock also has birds outside the unit cube the birds spawn in.
+struct NeighbourCase {
+    string name;
+    double coherence, alignment, separation;
+    int num_birds;
+    bool scattered;
+};
+
+// Moves every fourth bird somewhere in [-0.5, 1.5]^3, past the spawn cube
+// on every side but not so far that the grid has to grow its cells.
+void scatterBirds(Flock& flock, uint64_t seed) {
+    FlockRandom rng(seed + 1);
+    for (int index = 0; index < (int)flock.state.size(); index += 4) {
+        flock.state.setPosition(index, Vector3D(rng.uniform(-0.5, 1.5, index, 0, 0),
+                                                rng.uniform(-0.5, 1.5, index, 0, 1),
+                                                rng.uniform(-0.5, 1.5, index, 0, 2)));
+    }
+    flock.neighbour_grid.invalidate();
+}
+
+// Steps the flock and after every step compares, for every bird and each of
+// the three ranges, the neighbours the grid finds with the brute force ones.
+bool checkNeighbours(const CheckOptions& options, const NeighbourCase& check, bool incremental_grid) {
+    FlockParameters params = options.fp;
+    params.coherence = check.coherence;
+    params.alignment = check.alignment;
+    params.separation = check.separation;
+    params.num_birds = check.num_birds;
+    HeadlessScene scene;
+    if (!scene.load(options.scene, params, options.seed)) {
+        return false;
+    }
+    Flock& flock = scene.flock;
+    const FlockParameters& fp = scene.fp;
+    flock.incremental_grid = incremental_grid;
+    flock.buildGrid();
+    if (check.scattered) {
+        scatterBirds(flock, options.seed);
+    }
+    // simulate() builds the grid for the same ranges, so an in place grid is
+    // updated here rather than built again
+    vector<double> range = {fp.coherence, fp.alignment, fp.separation};
+    long queries = 0, candidates = 0, neighbours = 0, mismatches = 0;
+    for (int i = 0; i < options.num_steps; i++) {
+        scene.step(false);
+        flock.build_neighbour_grid(*max_element(range.begin(), range.end()));
+        for (int index = 0; index < (int)flock.state.size(); index++) {
+            vector<vector<int>> grid = flock.getNeighbours(index, range);
+            vector<vector<int>> exact = flock.getNeighboursBruteForce(index, range);
+            for (size_t r = 0; r < range.size(); r++) {
+                sort(grid[r].begin(), grid[r].end());
+                sort(exact[r].begin(), exact[r].end());
+                neighbours += exact[r].size();
+                if (grid[r] != exact[r] && mismatches++ == 0) {
+                    printf("         bird %d in step %d: %zu neighbours within %g in the grid, %zu in the flock\n",
+                           index, i, grid[r].size(), range[r], exact[r].size());
+                }
+            }
+            flock.neighbour_grid.query(flock.state.position(index), [&](int) { candidates++; });
+            queries++;
+        }
+    }
+    const SpatialGrid& grid = flock.neighbour_grid;
+    printf("Grid:    %s, %s %g/%g/%g, %d birds%s over %d steps\n", incremental_grid ? "updated in place" : "rebuilt",
+           check.name.c_str(), range[0], range[1], range[2], check.num_birds, check.scattered ? " scattered" : "",
+           options.num_steps);
+    printf("         %dx%dx%d cells of %g, %.1f birds queried and %.1f neighbours a bird and range: %s\n",
+           grid.dim_x, grid.dim_y, grid.dim_z, grid.cell_size, (double)candidates / max(queries, 1L),
+           (double)neighbours / max(queries * (long)range.size(), 1L),
+           mismatches == 0 ? "same neighbours" : (to_string(mismatches) + " DIFFERENT neighbour sets").c_str());
+    return mismatches == 0;
+}
+
+// Steps a flock, saves it and steps it on, then restores the save into a
+// fresh flock of the same scene and steps that as far.
+bool checkCheckpoint(const CheckOptions& options) {
+    string path = tempDirectory() + "/flock_check_" + to_string(options.seed) + ".checkpoint";
+    HeadlessScene saved, restored;
+    if (!saved.load(options.scene, options.fp, options.seed) ||
+        !restored.load(options.scene, options.fp, options.seed)) {
+        return false;
+    }
+    saved.flock.buildGrid();
+    for (int i = 0; i < options.num_steps; i++) {
+        saved.step(false);
+    }
+    if (!saveCheckpoint(path, saved.flock, saved.fp)) {
+        return false;
+    }
+    bool loaded = loadCheckpoint(path, restored.flock, restored.fp);
+    remove(path.c_str());
+    if (!loaded) {
+        return false;
+    }
+    for (int i = 0; i < options.num_steps; i++) {
+        saved.step(false);
+        restored.step(false);
+    }
+    bool same = sameFlock(saved.flock, restored.flock);
+    printf("Checkpt: %zu birds saved after %d steps and restored, %d steps on: %s\n",
+           saved.flock.state.size(), options.num_steps, options.num_steps,
+           same ? "same flock" : "DIFFERENT flocks");
+    return same;
+}
+
+int main(int argc, char** argv) {
+    CheckOptions options;
+    bool file_specified = false;
+    options.fp = FlockParameters(0.67, 0.5, 0.5); // FlockSimulator's default ranges
+    options.fp.num_birds = 1000;
+    options.num_steps = 20;
+    options.seed = 0;
+    bool check_neighbours = false;
+    bool check_checkpoint = false;
+    double range = 0;
+
+    enum { OPT_SEED = 256, OPT_NEIGHBOURS, OPT_CHECKPOINT };
+    const struct option long_options[] = {
+        {"seed", required_argument, NULL, OPT_SEED},
+        {"neighbours", no_argument, NULL, OPT_NEIGHBOURS},
+        {"checkpoint", no_argument, NULL, OPT_CHECKPOINT},
+        {NULL, 0, NULL, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "f:n:s:r:", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'f': {
+            options.scene = optarg;
+            file_specified = true;
+            break;
+        }
+        case 'n': {
+            options.fp.num_birds = max(atoi(optarg), 2);
+            break;
+        }
+        case 's': {
+            options.num_steps = max(atoi(optarg), 1);
+            break;
+        }
+        case 'r': {
+            range = max(atof(optarg), 1e-3);
+            break;
+        }
+        case OPT_SEED: {
+            options.seed = strtoull(optarg, NULL, 0);
+            break;
+        }
+        case OPT_NEIGHBOURS: {
+            check_neighbours = true;
+            break;
+        }
+        case OPT_CHECKPOINT: {
+            check_checkpoint = true;
+            break;
+        }
+        default: {
+            usageError(argv[0]);
+            break;
+        }
+        }
+    }
+    if (!file_specified && !find_default_scene(options.scene)) {
+        cout << "Error: No scene given and scene/env.json not found" << endl;
+        return -1;
+    }
+    bool all = !check_neighbours && !check_checkpoint;
+
+    bool ok = true;
+    if (all || check_neighbours) {
+        const FlockParameters& fp = options.fp;
+        int n = fp.num_birds;
+        vector<NeighbourCase> cases;
+        if (range > 0) {
+            cases.push_back({"range", range, range, range, n, false});
+            cases.push_back({"range", range, range, range, n, true});
+        } else {
+            cases.push_back({"viewer's ranges", fp.coherence, fp.alignment, fp.separation, n, false});
+            cases.push_back({"small ranges", 0.1, 0.05, 0.02, 2 * n, false});
+            cases.push_back({"small ranges", 0.1, 0.05, 0.02, 2 * n, true});
+        }
+        for (const NeighbourCase& check : cases) {
+            ok = checkNeighbours(options, check, false) && ok;
+            ok = checkNeighbours(options, check, true) && ok;
+        }
+    }
+    if (all || check_checkpoint) {
+        ok = checkCheckpoint(options) && ok;
+    }
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,230 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "flockCheckpoint.h"
+
+#include "flock.h"
+#include "misc/file_utils.h"
+
+using namespace std;
+
+namespace
+{
+
+struct CheckpointHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t cold_size; // sizeof(BirdColdState) of the writer
+  uint32_t num_species;
+  uint64_t num_birds;
+  uint64_t num_ids; // ids ever handed out, the length of generation
+  uint64_t step_count;
+  uint64_t seed;
+  double coherence_weight, alignment_weight, separation_weight;
+  int32_t flock_num_birds;
+  int32_t fp_num_birds;
+  double coherence, alignment, separation;
+};
+
+const char CHECKPOINT_MAGIC[8] = {'F', 'L', 'O', 'C', 'K', 'C', 'K', 'P'};
+const uint32_t CHECKPOINT_VERSION = 1;
+const uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
+const size_t SECTION_ALIGNMENT = 64;
+
+size_t padded(size_t bytes)
+{
+  return (bytes + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+}
+
+// Bytes of everything after the header, which comes first, padded too.
+size_t bodySize(const CheckpointHeader &header)
+{
+  size_t n = header.num_birds;
+  return 9 * padded(n * sizeof(float)) + 2 * padded(n * sizeof(uint32_t)) +
+         padded(header.num_ids * sizeof(uint32_t)) + padded(n * sizeof(uint8_t)) +
+         padded(header.num_species * sizeof(BirdSpecies)) + padded(n * sizeof(BirdColdState));
+}
+
+template <typename T>
+bool writeSection(FILE *file, const T *data, size_t count)
+{
+  static const char zeros[SECTION_ALIGNMENT] = {};
+  size_t bytes = count * sizeof(T), padding = padded(bytes) - bytes;
+  return fwrite(data, 1, bytes, file) == bytes && fwrite(zeros, 1, padding, file) == padding;
+}
+
+template <typename T>
+const T *section(const char *&p, size_t count)
+{
+  const T *first = reinterpret_cast<const T *>(p);
+  p += padded(count * sizeof(T));
+  return first;
+}
+
+// One copy, from the mapping into the vector's own storage.
+template <typename Vector>
+void adopt(Vector &v, const char *&p, size_t count)
+{
+  const typename Vector::value_type *first = section<typename Vector::value_type>(p, count);
+  v.assign(first, first + count);
+}
+
+} // namespace
+
+bool saveCheckpoint(const string &path, Flock &flock, const FlockParameters &fp)
+{
+  const FlockState &state = flock.state;
+  size_t n = state.size();
+
+  CheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+  header.version = CHECKPOINT_VERSION;
+  header.byte_order = CHECKPOINT_BYTE_ORDER;
+  header.cold_size = sizeof(BirdColdState);
+  header.num_species = state.species.size();
+  header.num_birds = n;
+  header.num_ids = state.generation.size();
+  header.step_count = flock.step_count;
+  header.seed = flock.rng.seed;
+  header.coherence_weight = flock.coherence_weight;
+  header.alignment_weight = flock.alignment_weight;
+  header.separation_weight = flock.separation_weight;
+  header.flock_num_birds = flock.num_birds;
+  header.fp_num_birds = fp.num_birds;
+  header.coherence = fp.coherence;
+  header.alignment = fp.alignment;
+  header.separation = fp.separation;
+
+  // Writes next to the final name and renames, so a reader never sees half
+  // a checkpoint.
+  string temp_path = path + ".tmp";
+  FILE *file = fopen(temp_path.c_str(), "wb");
+  if (!file)
+  {
+    cout << "Error: cannot write " << temp_path << endl;
+    return false;
+  }
+  bool written = writeSection(file, &header, 1);
+  const float *floats[9] = {state.px.data(), state.py.data(), state.pz.data(), state.vx.data(), state.vy.data(),
+                            state.vz.data(), state.ax.data(), state.ay.data(), state.az.data()};
+  for (const float *array : floats)
+  {
+    written = written && writeSection(file, array, n);
+  }
+  written = written && writeSection(file, state.id.data(), n);
+  written = written && writeSection(file, state.index_of.data(), n);
+  written = written && writeSection(file, state.generation.data(), state.generation.size());
+  written = written && writeSection(file, state.species_id.data(), n);
+  written = written && writeSection(file, state.species.data(), state.species.size());
+  written = written && writeSection(file, state.cold.data(), n);
+  written = fclose(file) == 0 && written;
+#ifdef _WIN32
+  remove(path.c_str());
+#endif
+  if (!written || rename(temp_path.c_str(), path.c_str()) != 0)
+  {
+    remove(temp_path.c_str());
+    cout << "Error: cannot write " << path << endl;
+    return false;
+  }
+
+  flock.neighbour_list.invalidate();
+  flock.neighbour_grid.invalidate();
+  return true;
+}
+
+bool loadCheckpoint(const string &path, Flock &flock, FlockParameters &fp)
+{
+  FileUtils::MappedFile file;
+  CheckpointHeader header;
+  if (!file.open(path))
+  {
+    cout << "Error: cannot open " << path << endl;
+    return false;
+  }
+  if (file.size() < sizeof(header))
+  {
+    cout << "Error: " << path << " is not a flock checkpoint" << endl;
+    return false;
+  }
+  memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, CHECKPOINT_MAGIC, 8) != 0)
+  {
+    cout << "Error: " << path << " is not a flock checkpoint" << endl;
+    return false;
+  }
+  if (header.version != CHECKPOINT_VERSION || header.byte_order != CHECKPOINT_BYTE_ORDER ||
+      header.cold_size != sizeof(BirdColdState))
+  {
+    cout << "Error: " << path << " was written by another version or machine" << endl;
+    return false;
+  }
+  size_t n = header.num_birds;
+  if (n > file.size() || header.num_ids > file.size() || header.num_species > file.size() ||
+      header.num_species == 0 || header.num_ids < n ||
+      file.size() != padded(sizeof(header)) + bodySize(header))
+  {
+    cout << "Error: " << path << " is truncated or damaged" << endl;
+    return false;
+  }
+
+  // Check the tables before touching the flock.
+  const char *p = file.data() + padded(sizeof(header));
+  const char *arrays = p;
+  p += 9 * padded(n * sizeof(float));
+  const uint32_t *id = section<uint32_t>(p, n);
+  const uint32_t *index_of = section<uint32_t>(p, n);
+  section<uint32_t>(p, header.num_ids);
+  const uint8_t *species_id = section<uint8_t>(p, n);
+  bool consistent = true;
+  for (size_t i = 0; i < n && consistent; i++)
+  {
+    consistent = id[i] < n && index_of[id[i]] == i && species_id[i] < header.num_species;
+  }
+  if (!consistent)
+  {
+    cout << "Error: " << path << " has inconsistent bird ids" << endl;
+    return false;
+  }
+
+  FlockState &state = flock.state;
+  p = arrays;
+  Misc::AlignedVector<float> *floats[9] = {&state.px, &state.py, &state.pz, &state.vx, &state.vy,
+                                           &state.vz, &state.ax, &state.ay, &state.az};
+  for (Misc::AlignedVector<float> *array : floats)
+  {
+    adopt(*array, p, n);
+  }
+  adopt(state.id, p, n);
+  adopt(state.index_of, p, n);
+  adopt(state.generation, p, header.num_ids);
+  adopt(state.species_id, p, n);
+  adopt(state.species, p, header.num_species);
+  adopt(state.cold, p, n);
+  // the step reads the front buffer only
+  state.back.px = state.px; state.back.py = state.py; state.back.pz = state.pz;
+  state.back.vx = state.vx; state.back.vy = state.vy; state.back.vz = state.vz;
+
+  flock.birds.assign(n, Bird(BirdHandle()));
+  for (size_t index = 0; index < n; index++)
+  {
+    flock.birds[state.id[index]] = Bird(state.handle(index));
+  }
+  flock.neighbour_list.invalidate();
+  flock.neighbour_grid.invalidate();
+  flock.step_count = header.step_count;
+  flock.rng.seed = header.seed;
+  flock.coherence_weight = header.coherence_weight;
+  flock.alignment_weight = header.alignment_weight;
+  flock.separation_weight = header.separation_weight;
+  flock.num_birds = header.flock_num_birds;
+  fp.num_birds = header.fp_num_birds;
+  fp.coherence = header.coherence;
+  fp.alignment = header.alignment;
+  fp.separation = header.separation;
+  return true;
+}
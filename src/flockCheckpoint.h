@@ -0,0 +1,29 @@
+#ifndef FLOCK_CHECKPOINT_H
+#define FLOCK_CHECKPOINT_H
+
+#include <string>
+
+struct Flock;
+struct FlockParameters;
+
+// A flock saved to a binary file and read back exactly: every bird's
+// position, speed, steering and perch state (able_stop, branch,
+// rand_stop_pos and the rest of BirdColdState) in index order with the ids,
+// the species, the random number seed and step count, the steering weights,
+// and the FlockParameters. A restored flock steps on exactly as the saved
+// one does, so a scenario can be picked up without letting a new flock
+// settle again.
+//
+// The file is a header and one 64-byte aligned array per field, in the byte
+// order of the machine that wrote it. Files of another version, byte order
+// or build are refused.
+
+// Saving drops the flock's neighbour lists and grid, which a restored flock
+// starts without, so that both take the same steps from here.
+bool saveCheckpoint(const std::string &path, Flock &flock, const FlockParameters &fp);
+
+// Maps the file and copies the arrays straight out of the mapping. On
+// failure prints why and leaves the flock and fp as they were.
+bool loadCheckpoint(const std::string &path, Flock &flock, FlockParameters &fp);
+
+#endif /* FLOCK_CHECKPOINT_H */
@@ -0,0 +1,235 @@
+#include <chrono>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include "misc/getopt.h" // getopt for windows
+#else
+#include <getopt.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "collision/cylinder.h"
+#include "flockBench.h"
+#include "flockRandom.h"
+#include "steeringKernel.h"
+
+using namespace std;
+
+// Times the flock's collision tests without a window: a pass of the flock
+// through the scene's collision objects a bird at a time against an object
+// at a time, and the bird-branch test against a generated forest with the
+// scalar kernel against the SIMD one. The flock is stepped first so that the
+// birds are spread as in a run.
+
+void usageError(const char* binaryName) {
+    printf("Usage: %s [options]\n", binaryName);
+    printf("Program options:\n");
+    printf("  -f     <STRING>    Filename of scene.\n");
+    printf("                     Defaults to scene/env.json under the project root.\n");
+    printf("  -n     <INT>       Number of birds.\n");
+    printf("  -s     <INT>       Number of simulation steps before the passes are timed.\n");
+    printf("  -t     <INT>       Number of simulation threads.\n");
+    printf("  -c     <INT>       Replace the scene's tree with a generated forest of this many\n");
+    printf("                     branches, and time the bird-branch collisions against it.\n");
+    printf("  --seed <INT>       Seed of the simulation's random numbers. Defaults to 0.\n");
+    printf("\n");
+    exit(-1);
+}
+
+// One pass of Cylinder::collide's capsule test over the whole flock, with
+// the scalar kernel and with the one the run picked.
+struct ForestTiming {
+    int birds = 0, capsules = 0;
+    double scalar_seconds = 0, simd_seconds = 0;
+    int scalar_hits = 0, simd_hits = 0;
+    bool same_result = true;
+};
+
+struct CollisionTiming {
+    int birds = 0, objects = 0;
+    double single_seconds = 0, batched_seconds = 0;
+    bool same_result = true;
+};
+
+enum { FOREST_X, FOREST_Z, FOREST_TRUNK, FOREST_HEIGHT, FOREST_TILT, FOREST_TURN, FOREST_LENGTH };
+
+// A forest over the birds' box: trunks two units tall, 8 branches to a trunk
+// on average, each branch sticking out of a random trunk at a random height
+// and angle. The trunks are the poles, so every branch is a perch.
+Cylinder* generateForest(int num_branches, uint64_t seed) {
+    FlockRandom rng(seed);
+    int num_trunks = max(num_branches / 8, 1);
+    vector<Vector3D> points;
+    vector<vector<double> > rotates;
+    vector<double> radius, half_length;
+    for (int i = 0; i < num_trunks; i++) {
+        points.push_back(Vector3D(rng.uniform(-2, 3, i, 0, FOREST_X), 1, rng.uniform(-2, 3, i, 0, FOREST_Z)));
+        rotates.push_back({0, 0});
+        radius.push_back(0.03);
+        half_length.push_back(1);
+    }
+    for (int i = 0; i < num_branches; i++) {
+        const Vector3D& trunk = points[(int)(rng.uniform(i, 0, FOREST_TRUNK) * num_trunks)];
+        vector<double> rotate = {rng.uniform(30, 80, i, 0, FOREST_TILT), rng.uniform(0, 360, i, 0, FOREST_TURN)};
+        double l = rng.uniform(0.2, 0.6, i, 0, FOREST_LENGTH);
+        Vector3D root(trunk.x, rng.uniform(0.3, 1.9, i, 0, FOREST_HEIGHT), trunk.z);
+        // the cylinder's own axis is y; put its lower end on the trunk
+        Vector3D direction = Cylinder::rotation(rotate) * Vector3D(0, 1, 0);
+        if (direction.y < 0) {
+            direction = -direction;
+        }
+        points.push_back(root + direction * l);
+        rotates.push_back(rotate);
+        radius.push_back(0.015);
+        half_length.push_back(l);
+    }
+    return new Cylinder(points, rotates, radius, half_length, 16, 0.5, num_branches, num_trunks);
+}
+
+// Times one collision pass of the current flock against the forest, on
+// copies of the positions and speeds so that both kernels see the same birds.
+ForestTiming timeForest(const Flock& flock, const Cylinder& forest) {
+    ForestTiming timing;
+    timing.birds = flock.state.size();
+    timing.capsules = forest.capsules.size();
+    FlockCopy scalar(flock.state), simd(flock.state);
+    FlockCopy* copies[2] = {&scalar, &simd};
+    SteeringKernelType types[2] = {STEERING_KERNEL_SCALAR, steeringKernelType()};
+    double* seconds[2] = {&timing.scalar_seconds, &timing.simd_seconds};
+    int* hits[2] = {&timing.scalar_hits, &timing.simd_hits};
+    for (int k = 0; k < 2; k++) {
+        auto start = chrono::steady_clock::now();
+        *hits[k] = forest.capsules.collide(copies[k]->span, 0, timing.birds, Cylinder::BIRD_RADIUS, forest.friction,
+                                           types[k]);
+        *seconds[k] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    timing.same_result = scalar.sameBirds(simd);
+    return timing;
+}
+
+// Times a pass of the whole flock through the scene's collision objects,
+// once with a call per bird and object (the single-bird collide) and once
+// with a call per object over all birds, as Flock::simulate does. Each is the
+// best of a few passes, on fresh copies of the flock.
+CollisionTiming timeCollisions(const Flock& flock, const vector<CollisionObject*>& objects) {
+    const int passes = 5;
+    CollisionTiming timing;
+    timing.birds = flock.state.size();
+    timing.objects = objects.size();
+    timing.single_seconds = timing.batched_seconds = 1e30;
+    for (int pass = 0; pass < passes; pass++) {
+        FlockCopy single(flock.state), batched(flock.state);
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < timing.birds; i++) {
+            for (CollisionObject* object : objects) {
+                object->collide(single.span, i);
+            }
+        }
+        timing.single_seconds = min(timing.single_seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        start = chrono::steady_clock::now();
+        for (CollisionObject* object : objects) {
+            object->collide(batched.span, 0, timing.birds);
+        }
+        timing.batched_seconds = min(timing.batched_seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        timing.same_result = timing.same_result && single.sameBirds(batched);
+    }
+    return timing;
+}
+
+int main(int argc, char** argv) {
+    string file_to_load_from;
+    bool file_specified = false;
+    FlockParameters fp(0.67, 0.5, 0.5); // FlockSimulator's default ranges
+    fp.num_birds = 2000;
+    int num_steps = 60;
+    int forest_branches = 0;
+    uint64_t seed = 0;
+
+    enum { OPT_SEED = 256 };
+    const struct option long_options[] = {
+        {"seed", required_argument, NULL, OPT_SEED},
+        {NULL, 0, NULL, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "f:n:s:t:c:", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'f': {
+            file_to_load_from = optarg;
+            file_specified = true;
+            break;
+        }
+        case 'n': {
+            fp.num_birds = max(atoi(optarg), 2);
+            break;
+        }
+        case 's': {
+            num_steps = max(atoi(optarg), 0);
+            break;
+        }
+        case 't': {
+#ifdef _OPENMP
+            omp_set_num_threads(max(atoi(optarg), 1));
+#else
+            cout << "Warn: Built without OpenMP, ignoring -t " << optarg << endl;
+#endif
+            break;
+        }
+        case 'c': {
+            forest_branches = max(atoi(optarg), 0);
+            break;
+        }
+        case OPT_SEED: {
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        }
+        default: {
+            usageError(argv[0]);
+            break;
+        }
+        }
+    }
+    if (!file_specified && !find_default_scene(file_to_load_from)) {
+        cout << "Error: No scene given and scene/env.json not found" << endl;
+        return -1;
+    }
+
+    HeadlessScene scene;
+    if (!scene.load(file_to_load_from, fp, seed)) {
+        return -1;
+    }
+    if (forest_branches > 0) {
+        scene.replacePerches(generateForest(forest_branches, seed));
+    }
+    scene.flock.buildGrid();
+    for (int i = 0; i < num_steps; i++) {
+        scene.step(false);
+    }
+    cout << "Scene:   " << file_to_load_from << ", " << fp.num_birds << " birds after " << num_steps << " steps"
+         << endl;
+
+    bool ok = true;
+    CollisionTiming collisions = timeCollisions(scene.flock, scene.objects);
+    printf("Collide: %d objects, a pass over the flock: %.1f ns per bird a call at a time,\n",
+           collisions.objects, collisions.single_seconds * 1e9 / collisions.birds);
+    printf("         %.1f ns per bird batched (%.2fx), %s\n", collisions.batched_seconds * 1e9 / collisions.birds,
+           collisions.single_seconds / max(collisions.batched_seconds, 1e-12),
+           collisions.same_result ? "same result" : "DIFFERENT results");
+    ok = collisions.same_result;
+    if (forest_branches > 0) {
+        ForestTiming forest = timeForest(scene.flock, *dynamic_cast<Cylinder*>(scene.objects[0]));
+        printf("Forest:  %d branches, %d capsules; one collision pass over the flock:\n", forest_branches,
+               forest.capsules);
+        printf("         scalar %.3f ms, %s %.3f ms (%.2fx), %.1f ns per bird-capsule test\n",
+               forest.scalar_seconds * 1e3, steeringKernelName(CapsuleSet::kernelType(steeringKernelType())),
+               forest.simd_seconds * 1e3,
+               forest.scalar_seconds / max(forest.simd_seconds, 1e-12),
+               forest.simd_seconds * 1e9 / max((double)forest.birds * forest.capsules, 1.));
+        printf("         %d of %d birds hit a branch, %s\n", forest.simd_hits, forest.birds,
+               forest.same_result ? "the same for both kernels" : "DIFFERENT between the kernels");
+        ok = ok && forest.same_result;
+    }
+    return ok ? 0 : -1;
+}
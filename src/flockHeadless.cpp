@@ -0,0 +1,595 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include "misc/getopt.h" // getopt for windows
+#else
+#include <getopt.h>
+#include <unistd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "flockBench.h"
+#include "flockCheckpoint.h"
+#include "flockRandom.h"
+#include "misc/file_utils.h"
+#include "sceneLoader.h"
+#include "steeringKernel.h"
+
+using namespace std;
+
+// Runs the flock without a window, for batch and benchmark jobs on machines
+// without a display. Mirrors what FlockSimulator::drawContents does each
+// substep, minus the drawing.
+
+void usageError(const char* binaryName) {
+    printf("Usage: %s [options]\n", binaryName);
+    printf("Program options:\n");
+    printf("  -f     <STRING>    Filename of scene.\n");
+    printf("                     Defaults to scene/env.json under the project root.\n");
+    printf("  -n     <INT>       Number of birds.\n");
+    printf("  -s     <INT>       Number of simulation steps.\n");
+    printf("  -t     <INT>       Number of simulation threads.\n");
+    printf("                     Defaults to one per core.\n");
+    printf("  -r     <FLOAT>     Coherence, alignment and separation range.\n");
+    printf("                     Defaults to the viewer's 0.67, 0.5 and 0.5.\n");
+    printf("  -p                 Let birds perch, as when \"S\" is pressed in the viewer.\n");
+    printf("  -l     <FLOAT>     Skin of the Verlet neighbour lists.\n");
+    printf("                     0 rebuilds the neighbour grid every step instead.\n");
+    printf("                     With -l or -a, also times building the neighbour grid and\n");
+    printf("                     the spatial hash over the final flock, and counts their\n");
+    printf("                     heap allocations.\n");
+    printf("  -i                 Update the neighbour grid incrementally instead of rebuilding it.\n");
+    printf("  -o     <FLOAT>     Barnes-Hut octree with opening angle theta.\n");
+    printf("                     0 keeps the octree's sums exact.\n");
+    printf("  -m     <INT>       Reorder the birds along a Morton curve every this many steps.\n");
+    printf("                     0 (default) reorders when the neighbour lists are rebuilt,\n");
+    printf("                     -1 never reorders.\n");
+    printf("  -g                 Ramp the flock from 50 birds up to -n over the run and back\n");
+    printf("                     to 50 in the last step.\n");
+    printf("  -b                 Run again without neighbour lists (or without the octree,\n");
+    printf("                     with -o) and report the time saved.\n");
+    printf("  -a                 Fail if a step after the first allocates from the heap.\n");
+    printf("  --seed <INT>       Seed of the simulation's random numbers. Defaults to 0.\n");
+    printf("  --restore <FILE>   Start from a flock checkpoint instead of new birds; -n, -p\n");
+    printf("                     and the scene's flock parameters are then ignored.\n");
+    printf("  --checkpoint <FILE>\n");
+    printf("                     Save the flock to a checkpoint after the run.\n");
+    printf("\n");
+    exit(-1);
+}
+
+// Counts every operator new of the program, so a run can check that steps
+// after the first do not touch the heap. AlignedVector storage comes from
+// posix_memalign and is not counted; it only grows with the flock.
+static atomic<long> heap_allocations(0);
+
+void* operator new(size_t size) {
+    heap_allocations++;
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+// Hardware cache misses of this process, from Linux perf events: L1 data
+// and last level cache read misses. Counters the kernel or the machine does
+// not offer (no PMU in many VMs, or perf_event_paranoid > 2) read as -1.
+struct CacheCounters {
+    enum { L1D, LLC, NUM_COUNTERS };
+
+    CacheCounters() {
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+            fds[c] = -1;
+#ifdef __linux__
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = (c == L1D ? PERF_COUNT_HW_CACHE_L1D : PERF_COUNT_HW_CACHE_LL) |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            attr.disabled = 1;
+            attr.inherit = 1; // count the OpenMP threads too
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[c] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+        }
+    }
+    ~CacheCounters() {
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+            if (fds[c] >= 0) {
+                close(fds[c]);
+            }
+        }
+    }
+
+    void start() {
+#ifdef __linux__
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+            if (fds[c] >= 0) {
+                ioctl(fds[c], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[c], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    // Misses since start(), or -1.
+    long long read(int counter) const {
+        long long count = -1;
+        if (fds[counter] < 0 || ::read(fds[counter], &count, sizeof(count)) != sizeof(count)) {
+            return -1;
+        }
+        return count;
+    }
+
+    int fds[NUM_COUNTERS];
+};
+
+struct RunOptions {
+    int num_steps;
+    int reorder_interval; // see Flock::reorder_interval
+    bool ramp;            // grow the flock from RAMP_START birds, see runScene
+    bool is_stopped;
+    double neighbour_skin;
+    bool incremental_grid;
+    double octree_theta; // < 0 runs without the octree
+    uint64_t seed;
+    string restore_path;    // checkpoint to start from, if any
+    string checkpoint_path; // to save to after the run, if any
+    bool report_rebuilds;   // time the grid and spatial hash builds, see timeRebuilds
+};
+
+// How far the octree's sums are from the exact ones, over a sample of birds.
+struct OctreeAccuracy {
+    int samples = 0;
+    double cohesion_mean = 0, cohesion_max = 0;   // distance between the centres
+    double alignment_mean = 0, alignment_max = 0; // angle between the speed sums, degrees
+    double count_mean = 0;                        // relative error of the neighbour counts
+};
+
+// Heap allocations and time of building a neighbour structure over the final
+// flock from nothing, then of rebuilding it over the same birds.
+struct RebuildTiming {
+    long first_allocations = 0, rebuild_allocations = 0;
+    double first_seconds = 0, rebuild_seconds = 0;
+    int cells = 0;
+};
+
+struct RunResult {
+    double seconds;
+    double bird_steps;
+    long allocations; // heap allocations after the first step
+    long long cache_misses[CacheCounters::NUM_COUNTERS]; // after the first step, or -1
+    Vector3D center;
+    NeighbourStats stats;
+    OctreeAccuracy accuracy;
+    RebuildTiming grid, hash;
+    double restore_seconds = 0;
+    size_t restored_birds = 0;
+    double checkpoint_seconds = 0;
+};
+
+// Compares the octree's cohesion and alignment for the current positions
+// with the exact neighbours from Flock::getNeighbours.
+OctreeAccuracy measureOctree(Flock& flock, const FlockParameters& fp) {
+    const int max_samples = 256;
+    OctreeAccuracy accuracy;
+    int num = flock.state.size();
+    vector<double> range = {fp.coherence, fp.alignment};
+    flock.build_neighbour_grid(max(fp.coherence, fp.alignment));
+    flock.octree.build(flock.state);
+    SteeringKernel kernel = steeringKernel();
+    for (int s = 0; s < min(num, max_samples); s++) {
+        int index = flock.state.index_of[(long)s * num / min(num, max_samples)];
+        Vector3D position = flock.state.position(index);
+        vector<vector<int>> exact = flock.getNeighbours(index, range);
+        if (exact[0].empty() || exact[1].empty()) {
+            continue;
+        }
+        Vector3D center, speed;
+        for (int j : exact[0]) {
+            center += flock.state.position(j);
+        }
+        center /= exact[0].size();
+        for (int j : exact[1]) {
+            speed += flock.state.speed(j);
+        }
+
+        SteeringQuery query;
+        query.x = flock.state.px[index];
+        query.y = flock.state.py[index];
+        query.z = flock.state.pz[index];
+        query.cohesion_r2 = fp.coherence * fp.coherence;
+        query.separation_r2 = -1;
+        query.alignment_r2 = fp.alignment * fp.alignment;
+        query.self = index;
+        SteeringSums sums;
+        flock.octree.accumulate(flock.state, kernel, query, flock.octree_theta, sums);
+        if (sums.cohesion_count == 0 || sums.alignment_count == 0) {
+            accuracy.samples++;
+            accuracy.cohesion_mean += 1e9; // should never happen, make it show
+            continue;
+        }
+        Vector3D octree_center = position + Vector3D(sums.cohesion[0], sums.cohesion[1], sums.cohesion[2]) / sums.cohesion_count;
+        Vector3D octree_speed(sums.alignment[0], sums.alignment[1], sums.alignment[2]);
+        double cohesion = (octree_center - center).norm();
+        double cosine = dot(octree_speed, speed) / max(octree_speed.norm() * speed.norm(), 1e-30);
+        double alignment = acos(CGL::clamp(cosine, -1., 1.)) * 180. / PI;
+        accuracy.samples++;
+        accuracy.cohesion_mean += cohesion;
+        accuracy.cohesion_max = max(accuracy.cohesion_max, cohesion);
+        accuracy.alignment_mean += alignment;
+        accuracy.alignment_max = max(accuracy.alignment_max, alignment);
+        accuracy.count_mean += fabs((double)sums.cohesion_count - exact[0].size()) / exact[0].size() / 2 +
+                               fabs((double)sums.alignment_count - exact[1].size()) / exact[1].size() / 2;
+    }
+    if (accuracy.samples > 0) {
+        accuracy.cohesion_mean /= accuracy.samples;
+        accuracy.alignment_mean /= accuracy.samples;
+        accuracy.count_mean /= accuracy.samples;
+    }
+    return accuracy;
+}
+
+// Builds a fresh structure over the flock with build(structure), then
+// rebuilds it a few times and keeps the average.
+template <typename Structure, typename Build>
+RebuildTiming timeRebuilds(Build build) {
+    const int rebuilds = 5;
+    RebuildTiming timing;
+    Structure structure;
+    long allocations = heap_allocations;
+    auto start = chrono::steady_clock::now();
+    build(structure);
+    timing.first_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    timing.first_allocations = heap_allocations - allocations;
+    allocations = heap_allocations;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rebuilds; r++) {
+        build(structure);
+    }
+    timing.rebuild_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / rebuilds;
+    timing.rebuild_allocations = (heap_allocations - allocations) / rebuilds;
+    timing.cells = structure.numCells();
+    return timing;
+}
+
+const int RAMP_START = 50;
+
+// Population of step `step` of a ramp: RAMP_START birds growing geometrically
+// to the requested number by the second to last step, and back to
+// RAMP_START in the last one.
+int rampPopulation(int step, int num_steps, int num_birds) {
+    if (step >= num_steps - 1 || num_steps < 3) {
+        return step == 0 ? num_birds : RAMP_START;
+    }
+    double t = (double)step / (num_steps - 2);
+    return (int)(RAMP_START * pow((double)num_birds / RAMP_START, t) + 0.5);
+}
+
+// Loads the scene into a fresh flock and steps it. Runs with the same seed
+// see the same birds.
+bool runScene(const string& scene_file, const FlockParameters& params, const RunOptions& options,
+              RunResult& result) {
+    HeadlessScene scene;
+    if (!scene.load(scene_file, params, options.seed)) {
+        return false;
+    }
+    Flock& flock = scene.flock;
+    FlockParameters& fp = scene.fp;
+
+    int num_birds = fp.num_birds;
+    if (options.ramp) {
+        fp.num_birds = rampPopulation(0, options.num_steps, num_birds);
+    }
+    flock.num_birds = fp.num_birds;
+    flock.neighbour_skin = options.neighbour_skin;
+    flock.incremental_grid = options.incremental_grid;
+    flock.octree_mode = options.octree_theta >= 0;
+    flock.octree_theta = max(options.octree_theta, 0.);
+    flock.reorder_interval = options.reorder_interval;
+    if (options.restore_path.empty()) {
+        flock.buildGrid();
+        flock.set_stop(options.is_stopped);
+    } else {
+        auto restore_start = chrono::steady_clock::now();
+        if (!loadCheckpoint(options.restore_path, flock, fp)) {
+            return false;
+        }
+        result.restore_seconds = chrono::duration<double>(chrono::steady_clock::now() - restore_start).count();
+        result.restored_birds = flock.state.size();
+        num_birds = fp.num_birds;
+    }
+
+    CacheCounters cache;
+    auto start = chrono::steady_clock::now();
+    long allocations_before = 0;
+    result.bird_steps = 0;
+    for (int i = 0; i < options.num_steps; i++) {
+        if (options.ramp) {
+            fp.num_birds = rampPopulation(i, options.num_steps, num_birds);
+        }
+        result.bird_steps += fp.num_birds;
+        // the first step sizes the grid, the lists and OpenMP's thread pool
+        if (i == 1) {
+            allocations_before = heap_allocations;
+            cache.start();
+        }
+        scene.step(options.is_stopped);
+    }
+    result.allocations = options.num_steps > 1 ? heap_allocations - allocations_before : 0;
+    for (int c = 0; c < CacheCounters::NUM_COUNTERS; c++) {
+        result.cache_misses[c] = options.num_steps > 1 ? cache.read(c) : -1;
+    }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (!options.checkpoint_path.empty()) {
+        auto checkpoint_start = chrono::steady_clock::now();
+        if (!saveCheckpoint(options.checkpoint_path, flock, fp)) {
+            return false;
+        }
+        result.checkpoint_seconds = chrono::duration<double>(chrono::steady_clock::now() - checkpoint_start).count();
+    }
+
+    // summed by id, so reordering the birds does not change the rounding
+    result.center = Vector3D();
+    for (size_t id = 0; id < flock.state.size(); id++) {
+        result.center += flock.state.position(flock.state.index_of[id]);
+    }
+    result.center /= flock.state.size();
+    result.stats = flock.neighbour_stats;
+    if (flock.octree_mode) {
+        result.accuracy = measureOctree(flock, fp);
+    }
+    if (options.report_rebuilds) {
+        double radius = max(max(fp.coherence, fp.alignment), fp.separation) + options.neighbour_skin;
+        result.grid = timeRebuilds<SpatialGrid>([&](SpatialGrid& grid) { grid.build(flock.state, radius); });
+        Vector3D cell_size = flock.spatial_cell_size();
+        result.hash = timeRebuilds<SpatialHash>([&](SpatialHash& hash) { hash.build(flock.state, cell_size); });
+    }
+    return true;
+}
+
+void printRebuildTiming(const char* what, const RebuildTiming& timing) {
+    printf("         %s: %d cells, first build %.3f ms and %ld allocations, then %.3f ms and %ld\n", what,
+           timing.cells, timing.first_seconds * 1e3, timing.first_allocations, timing.rebuild_seconds * 1e3,
+           timing.rebuild_allocations);
+}
+
+void printNeighbourStats(const NeighbourStats& stats) {
+    printf("         rebuilt %ld of %ld steps (every %.1f), %ld lists too large, %ld reorders\n",
+           stats.rebuilds, stats.steps, (double)stats.steps / max(stats.rebuilds, 1L), stats.overflows,
+           stats.reorders);
+    printf("         per step: %.3f ms rebuilding, %.3f ms checking, %.3f ms steering, %.3f ms reordering\n",
+           stats.rebuild_seconds * 1e3 / stats.steps, stats.check_seconds * 1e3 / stats.steps,
+           stats.steering_seconds * 1e3 / stats.steps, stats.reorder_seconds * 1e3 / stats.steps);
+    printf("         of which %.3f ms building grids, apart from steering\n", stats.grid_seconds * 1e3 / stats.steps);
+    if (stats.collided > 0) {
+        printf("         collisions: %.3f ms per step summed over threads, %.1f ns per bird\n",
+               stats.collision_seconds * 1e3 / stats.steps, stats.collision_seconds * 1e9 / stats.collided);
+    }
+    if (stats.grid_updates > 0) {
+        printf("         %ld of %ld grid builds incremental, %.1f migrations per update\n", stats.grid_updates,
+               stats.grid_builds, (double)stats.migrations / stats.grid_updates);
+    }
+}
+
+int main(int argc, char** argv) {
+    string file_to_load_from;
+    bool file_specified = false;
+    FlockParameters fp(0.67, 0.5, 0.5); // FlockSimulator's default ranges
+    int num_birds = 50;
+    RunOptions options;
+    options.num_steps = 300;
+    options.reorder_interval = Flock::REORDER_ADAPTIVE;
+    options.ramp = false;
+    options.is_stopped = false;
+    options.neighbour_skin = Flock().neighbour_skin;
+    options.incremental_grid = false;
+    options.octree_theta = -1;
+    options.report_rebuilds = false;
+    bool compare_baseline = false;
+    bool check_allocations = false;
+    options.seed = 0;
+
+    enum { OPT_SEED = 256, OPT_RESTORE, OPT_CHECKPOINT };
+    const struct option long_options[] = {
+        {"seed", required_argument, NULL, OPT_SEED},
+        {"restore", required_argument, NULL, OPT_RESTORE},
+        {"checkpoint", required_argument, NULL, OPT_CHECKPOINT},
+        {NULL, 0, NULL, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "f:n:s:t:r:pl:ibao:m:g", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'f': {
+            file_to_load_from = optarg;
+            file_specified = true;
+            break;
+        }
+        case 'n': {
+            num_birds = max(atoi(optarg), 2);
+            break;
+        }
+        case 's': {
+            options.num_steps = max(atoi(optarg), 1);
+            break;
+        }
+        case 't': {
+            int arg_int = atoi(optarg);
+            if (arg_int < 1) {
+                arg_int = 1;
+            }
+#ifdef _OPENMP
+            omp_set_num_threads(arg_int);
+#else
+            cout << "Warn: Built without OpenMP, ignoring -t " << arg_int << endl;
+#endif
+            break;
+        }
+        case 'r': {
+            fp.coherence = fp.alignment = fp.separation = max(atof(optarg), 0.);
+            break;
+        }
+        case 'p': {
+            options.is_stopped = true;
+            break;
+        }
+        case 'l': {
+            options.report_rebuilds = true;
+            options.neighbour_skin = max(atof(optarg), 0.);
+            break;
+        }
+        case 'i': {
+            options.incremental_grid = true;
+            break;
+        }
+        case 'b': {
+            compare_baseline = true;
+            break;
+        }
+        case 'o': {
+            options.octree_theta = max(atof(optarg), 0.);
+            break;
+        }
+        case 'm': {
+            options.reorder_interval = max(atoi(optarg), (int)Flock::REORDER_NEVER);
+            break;
+        }
+        case 'g': {
+            options.ramp = true;
+            break;
+        }
+        case 'a': {
+            check_allocations = true;
+            options.report_rebuilds = true;
+            break;
+        }
+        case OPT_SEED: {
+            options.seed = strtoull(optarg, NULL, 0);
+            break;
+        }
+        case OPT_RESTORE: {
+            options.restore_path = optarg;
+            break;
+        }
+        case OPT_CHECKPOINT: {
+            options.checkpoint_path = optarg;
+            break;
+        }
+        default: {
+            usageError(argv[0]);
+            break;
+        }
+        }
+    }
+
+    if (!file_specified && !find_default_scene(file_to_load_from)) {
+        cout << "Error: No scene given and scene/env.json not found" << endl;
+        return -1;
+    }
+
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    cout << "Scene:   " << file_to_load_from << endl;
+    cout << "Birds:   " << num_birds << ", threads: " << num_threads
+         << ", kernel: " << steeringKernelName(steeringKernelType())
+         << ", seed: " << options.seed << endl;
+
+    fp.num_birds = num_birds;
+    RunResult run;
+    if (!runScene(file_to_load_from, fp, options, run)) {
+        return -1;
+    }
+    int num_steps = options.num_steps;
+    printf("Steps:   %d in %.3f s\n", num_steps, run.seconds);
+    printf("Rate:    %.1f steps/s, %.3g bird-steps/s, %.1f ns/bird-step\n",
+           num_steps / run.seconds, run.bird_steps / run.seconds, run.seconds * 1e9 / run.bird_steps);
+    if (options.ramp) {
+        const NeighbourStats& stats = run.stats;
+        printf("Ramp:    %d to %d to %d birds, %ld spawned, %ld despawned\n", RAMP_START, num_birds,
+               RAMP_START, stats.spawned, stats.despawned);
+        printf("         %.3f ms spawning and despawning, %.1f ns/bird\n", stats.population_seconds * 1e3,
+               stats.population_seconds * 1e9 / max(stats.spawned + stats.despawned, 1L));
+    }
+    printf("Center:  %.9f %.9f %.9f\n", run.center.x, run.center.y, run.center.z);
+    if (!options.restore_path.empty()) {
+        printf("Restore: %s, %zu birds in %.3f ms\n", options.restore_path.c_str(), run.restored_birds,
+               run.restore_seconds * 1e3);
+    }
+    if (!options.checkpoint_path.empty()) {
+        ifstream checkpoint(options.checkpoint_path, ios::binary | ios::ate);
+        printf("Checkpt: %s, %.1f MB in %.3f ms\n", options.checkpoint_path.c_str(), checkpoint.tellg() / 1e6,
+               run.checkpoint_seconds * 1e3);
+    }
+    printf("Allocs:  %ld in steps 2-%d\n", run.allocations, num_steps);
+    if (run.cache_misses[CacheCounters::L1D] >= 0 || run.cache_misses[CacheCounters::LLC] >= 0) {
+        double steps = max(num_steps - 1, 1);
+        printf("Cache:   %.4g L1D, %.4g LLC read misses per step\n",
+               run.cache_misses[CacheCounters::L1D] / steps, run.cache_misses[CacheCounters::LLC] / steps);
+    } else {
+        printf("Cache:   miss counters unavailable\n");
+    }
+    bool octree_mode = options.octree_theta >= 0;
+    if (octree_mode) {
+        const OctreeAccuracy& accuracy = run.accuracy;
+        printf("Octree:  theta %g\n", options.octree_theta);
+        printNeighbourStats(run.stats);
+        printf("         error over %d birds: cohesion centre %.3g mean, %.3g max;\n",
+               accuracy.samples, accuracy.cohesion_mean, accuracy.cohesion_max);
+        printf("         alignment %.3g deg mean, %.3g deg max; counts %.3g%% mean\n",
+               accuracy.alignment_mean, accuracy.alignment_max, 100. * accuracy.count_mean);
+    } else {
+        printf("Lists:   skin %g\n", options.neighbour_skin);
+        printNeighbourStats(run.stats);
+    }
+    if (options.report_rebuilds) {
+        printf("Rebuild: over the final flock\n");
+        printRebuildTiming("neighbour grid", run.grid);
+        printRebuildTiming("spatial hash", run.hash);
+    }
+
+    if (compare_baseline && (octree_mode || options.neighbour_skin > 0)) {
+        RunOptions baseline_options = options;
+        baseline_options.checkpoint_path.clear();
+        if (octree_mode) {
+            baseline_options.octree_theta = -1;
+        } else {
+            baseline_options.neighbour_skin = 0;
+        }
+        RunResult baseline;
+        if (!runScene(file_to_load_from, fp, baseline_options, baseline)) {
+            return -1;
+        }
+        printf("Without: %.3f s (%.1f steps/s)\n", baseline.seconds, num_steps / baseline.seconds);
+        printf("Center:  %.9f %.9f %.9f\n", baseline.center.x, baseline.center.y, baseline.center.z);
+        printNeighbourStats(baseline.stats);
+        printf("Saved:   %.3f s, %.1f%% of the step time (%.2fx)\n", baseline.seconds - run.seconds,
+               100. * (baseline.seconds - run.seconds) / baseline.seconds, baseline.seconds / run.seconds);
+    }
+    if (check_allocations && run.allocations != 0) {
+        cout << "Error: " << run.allocations << " heap allocations after the first step" << endl;
+        return -1;
+    }
+    return 0;
+}
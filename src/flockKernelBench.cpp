@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include "misc/getopt.h" // getopt for windows
+#else
+#include <getopt.h>
+#endif
+
+#include "flockBench.h"
+#include "steeringKernel.h"
+
+using namespace std;
+
+// Times the steering kernels on the same input: the neighbour grid runs of
+// every bird of a stepped flock, as Flock::simulate hands them out. Reports
+// candidate pairs per second for each kernel the CPU runs and checks that
+// the SIMD kernels sum up what the scalar one does.
+
+void usageError(const char* binaryName) {
+    printf("Usage: %s [options]\n", binaryName);
+    printf("Program options:\n");
+    printf("  -f     <STRING>    Filename of scene.\n");
+    printf("                     Defaults to scene/env.json under the project root.\n");
+    printf("  -n     <INT>       Number of birds.\n");
+    printf("  -s     <INT>       Number of simulation steps before the kernels are timed.\n");
+    printf("  -r     <FLOAT>     Coherence, alignment and separation range.\n");
+    printf("                     Defaults to the viewer's 0.67, 0.5 and 0.5.\n");
+    printf("  -k     <INT>       Number of timed passes over the flock, the best is kept.\n");
+    printf("  --seed <INT>       Seed of the simulation's random numbers. Defaults to 0.\n");
+    printf("\n");
+    exit(-1);
+}
+
+// Sums of every bird after one pass of a kernel, and the best time of a pass.
+struct KernelRun {
+    SteeringKernelType type;
+    vector<SteeringSums> sums;
+    double seconds = 1e30;
+};
+
+void runKernel(const Flock& flock, const FlockParameters& fp, int passes, KernelRun& run) {
+    SteeringKernel kernel = steeringKernel(run.type);
+    const FlockState& state = flock.state;
+    int num = state.size();
+    run.sums.assign(num, SteeringSums());
+    for (int pass = 0; pass < passes; pass++) {
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < num; i++) {
+            SteeringQuery query;
+            query.x = state.px[i];
+            query.y = state.py[i];
+            query.z = state.pz[i];
+            query.cohesion_r2 = fp.coherence * fp.coherence;
+            query.separation_r2 = fp.separation * fp.separation;
+            query.alignment_r2 = fp.alignment * fp.alignment;
+            query.self = i;
+            SteeringSums& sums = run.sums[i];
+            sums.clear();
+            flock.neighbour_grid.queryRuns(state.position(i), [&](const int* indices, int count) {
+                kernel(state.px.data(), state.py.data(), state.pz.data(), state.vx.data(), state.vy.data(),
+                       state.vz.data(), indices, count, query, sums);
+            });
+        }
+        run.seconds = min(run.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+}
+
+// Counts must agree exactly, the kernels share the distance test. The float
+// sums differ only in the order they add up, so each may be off by a small
+// part of the largest sum its neighbours could make.
+bool sameSums(const SteeringSums& a, const SteeringSums& b, const FlockParameters& fp, double max_speed) {
+    const double tolerance = 1e-5;
+    if (a.cohesion_count != b.cohesion_count || a.separation_count != b.separation_count ||
+        a.alignment_count != b.alignment_count) {
+        return false;
+    }
+    for (int c = 0; c < 3; c++) {
+        if (fabs(a.cohesion[c] - b.cohesion[c]) > tolerance * a.cohesion_count * fp.coherence ||
+            fabs(a.separation[c] - b.separation[c]) > tolerance * a.separation_count * fp.separation ||
+            fabs(a.alignment[c] - b.alignment[c]) > tolerance * a.alignment_count * max_speed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    string file_to_load_from;
+    bool file_specified = false;
+    FlockParameters fp(0.67, 0.5, 0.5); // FlockSimulator's default ranges
+    fp.num_birds = 5000;
+    int num_steps = 20;
+    int passes = 5;
+    uint64_t seed = 0;
+
+    enum { OPT_SEED = 256 };
+    const struct option long_options[] = {
+        {"seed", required_argument, NULL, OPT_SEED},
+        {NULL, 0, NULL, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "f:n:s:r:k:", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'f': {
+            file_to_load_from = optarg;
+            file_specified = true;
+            break;
+        }
+        case 'n': {
+            fp.num_birds = max(atoi(optarg), 2);
+            break;
+        }
+        case 's': {
+            num_steps = max(atoi(optarg), 0);
+            break;
+        }
+        case 'r': {
+            fp.coherence = fp.alignment = fp.separation = max(atof(optarg), 0.);
+            break;
+        }
+        case 'k': {
+            passes = max(atoi(optarg), 1);
+            break;
+        }
+        case OPT_SEED: {
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        }
+        default: {
+            usageError(argv[0]);
+            break;
+        }
+        }
+    }
+    if (!file_specified && !find_default_scene(file_to_load_from)) {
+        cout << "Error: No scene given and scene/env.json not found" << endl;
+        return -1;
+    }
+
+    HeadlessScene scene;
+    if (!scene.load(file_to_load_from, fp, seed)) {
+        return -1;
+    }
+    const FlockParameters& ranges = scene.fp;
+    Flock& flock = scene.flock;
+    flock.buildGrid();
+    for (int i = 0; i < num_steps; i++) {
+        scene.step(false);
+    }
+    flock.incremental_grid = false;
+    flock.build_neighbour_grid(max(max(ranges.coherence, ranges.alignment), ranges.separation));
+
+    double pairs = 0, max_speed = 0;
+    for (size_t i = 0; i < flock.state.size(); i++) {
+        flock.neighbour_grid.queryRuns(flock.state.position(i), [&](const int*, int count) { pairs += count; });
+        max_speed = max(max_speed, flock.state.speed(i).norm());
+    }
+    printf("Flock:   %zu birds after %d steps, %.0f candidate pairs a pass, best of %d passes\n",
+           flock.state.size(), num_steps, pairs, passes);
+
+    SteeringKernelType types[] = {STEERING_KERNEL_SCALAR, STEERING_KERNEL_AVX2, STEERING_KERNEL_AVX512};
+    vector<KernelRun> runs;
+    for (SteeringKernelType type : types) {
+        if (!steeringKernel(type)) {
+            printf("%-8s not supported by this build or CPU\n", (string(steeringKernelName(type)) + ":").c_str());
+            continue;
+        }
+        runs.push_back(KernelRun());
+        runs.back().type = type;
+        runKernel(flock, ranges, passes, runs.back());
+    }
+
+    bool ok = true;
+    const KernelRun& scalar = runs[0];
+    for (const KernelRun& run : runs) {
+        long different = 0;
+        for (size_t i = 0; i < run.sums.size(); i++) {
+            different += !sameSums(scalar.sums[i], run.sums[i], ranges, max_speed);
+        }
+        printf("%-8s %.3f ms, %.3g pairs/s (%.2fx scalar), %s\n", (string(steeringKernelName(run.type)) + ":").c_str(),
+               run.seconds * 1e3, pairs / run.seconds, scalar.seconds / run.seconds,
+               different == 0 ? "same sums" : (to_string(different) + " birds DIFFERENT").c_str());
+        ok = ok && different == 0;
+    }
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,258 @@
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include "misc/getopt.h" // getopt for windows
+#else
+#include <getopt.h>
+#endif
+
+#include "flockBench.h"
+#include "steeringKernel.h"
+
+using namespace std;
+
+// Compares the flock's structure-of-arrays layout (FlockState) with the
+// vector<PointMass> it replaced, on the pass that dominates a step: the
+// neighbour loop of every bird over its neighbour grid runs. Both layouts
+// hold the same birds and visit the same candidates; the old one reads them
+// as the old step did, doubles out of one large struct per bird, the new one
+// with the scalar steering kernel.
+
+void usageError(const char* binaryName) {
+    printf("Usage: %s [options]\n", binaryName);
+    printf("Program options:\n");
+    printf("  -f     <STRING>    Filename of scene.\n");
+    printf("                     Defaults to scene/env.json under the project root.\n");
+    printf("  -n     <INT>       Number of birds.\n");
+    printf("  -s     <INT>       Number of simulation steps before the passes are timed.\n");
+    printf("  -r     <FLOAT>     Coherence, alignment and separation range.\n");
+    printf("                     Defaults to the viewer's 0.67, 0.5 and 0.5.\n");
+    printf("  -k     <INT>       Number of timed passes over the flock, the best is kept.\n");
+    printf("  --seed <INT>       Seed of the simulation's random numbers. Defaults to 0.\n");
+    printf("\n");
+    exit(-1);
+}
+
+// The bird as it was stored before FlockState: PointMass with its speed,
+// steering limits and perch state, one per bird in a vector.
+struct PointMassBird {
+    bool pinned;
+    Vector3D start_position;
+    Vector3D position;
+    Vector3D last_position;
+    Vector3D forces;
+    void* halfedge;
+    Vector3D speed;
+    Vector3D cumulatedSpeed;
+    double minSpeed, maxSpeed, maxAcc, minAcc;
+    Vector3D rand_stop_pos;
+    bool able_stop;
+    int branch;
+    int timer;
+};
+
+// Bytes of the 64-byte lines one neighbour visit reads from a bird, its
+// position and, for the alignment sum, its speed. A PointMass is not a
+// multiple of 64 bytes, so this is the average over where the birds start
+// in a line.
+double pointMassVisitBytes() {
+    const size_t fields[2] = {offsetof(PointMassBird, position), offsetof(PointMassBird, speed)};
+    double lines = 0;
+    int starts = 0;
+    for (size_t base = 0; base < 64; base += alignof(PointMassBird), starts++) {
+        size_t last_line = (size_t)-1;
+        for (size_t field : fields) {
+            for (size_t line = (base + field) / 64; line <= (base + field + sizeof(Vector3D) - 1) / 64; line++) {
+                lines += line != last_line;
+                last_line = line;
+            }
+        }
+    }
+    return lines / starts * 64;
+}
+
+double timePointMass(const Flock& flock, const vector<PointMassBird>& birds, const FlockParameters& fp,
+                     int passes, double& checksum) {
+    double seconds = 1e30;
+    double cohesion_r2 = fp.coherence * fp.coherence, separation_r2 = fp.separation * fp.separation;
+    double alignment_r2 = fp.alignment * fp.alignment;
+    for (int pass = 0; pass < passes; pass++) {
+        checksum = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < birds.size(); i++) {
+            const Vector3D& position = birds[i].position;
+            Vector3D cohesion, separation, alignment;
+            int count = 0;
+            flock.neighbour_grid.query(position, [&](int j) {
+                if (j == (int)i) {
+                    return;
+                }
+                Vector3D offset = birds[j].position - position;
+                double d2 = offset.norm2();
+                if (d2 < cohesion_r2) {
+                    cohesion += offset;
+                    count++;
+                }
+                if (d2 < separation_r2) {
+                    separation += offset;
+                    count++;
+                }
+                if (d2 < alignment_r2) {
+                    alignment += birds[j].speed;
+                    count++;
+                }
+            });
+            checksum += count + cohesion.x + separation.y + alignment.z;
+        }
+        seconds = min(seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    return seconds;
+}
+
+double timeFlockState(const Flock& flock, const FlockParameters& fp, SteeringKernelType type, int passes,
+                      double& checksum) {
+    SteeringKernel kernel = steeringKernel(type);
+    const FlockState& state = flock.state;
+    double seconds = 1e30;
+    for (int pass = 0; pass < passes; pass++) {
+        checksum = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < state.size(); i++) {
+            SteeringQuery query;
+            query.x = state.px[i];
+            query.y = state.py[i];
+            query.z = state.pz[i];
+            query.cohesion_r2 = fp.coherence * fp.coherence;
+            query.separation_r2 = fp.separation * fp.separation;
+            query.alignment_r2 = fp.alignment * fp.alignment;
+            query.self = i;
+            SteeringSums sums;
+            flock.neighbour_grid.queryRuns(state.position(i), [&](const int* indices, int count) {
+                kernel(state.px.data(), state.py.data(), state.pz.data(), state.vx.data(), state.vy.data(),
+                       state.vz.data(), indices, count, query, sums);
+            });
+            checksum += sums.cohesion_count + sums.separation_count + sums.alignment_count + sums.cohesion[0] +
+                        sums.separation[1] + sums.alignment[2];
+        }
+        seconds = min(seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    return seconds;
+}
+
+int main(int argc, char** argv) {
+    string file_to_load_from;
+    bool file_specified = false;
+    FlockParameters fp(0.67, 0.5, 0.5); // FlockSimulator's default ranges
+    fp.num_birds = 5000;
+    int num_steps = 20;
+    int passes = 5;
+    uint64_t seed = 0;
+
+    enum { OPT_SEED = 256 };
+    const struct option long_options[] = {
+        {"seed", required_argument, NULL, OPT_SEED},
+        {NULL, 0, NULL, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "f:n:s:r:k:", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'f': {
+            file_to_load_from = optarg;
+            file_specified = true;
+            break;
+        }
+        case 'n': {
+            fp.num_birds = max(atoi(optarg), 2);
+            break;
+        }
+        case 's': {
+            num_steps = max(atoi(optarg), 0);
+            break;
+        }
+        case 'r': {
+            fp.coherence = fp.alignment = fp.separation = max(atof(optarg), 0.);
+            break;
+        }
+        case 'k': {
+            passes = max(atoi(optarg), 1);
+            break;
+        }
+        case OPT_SEED: {
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        }
+        default: {
+            usageError(argv[0]);
+            break;
+        }
+        }
+    }
+    if (!file_specified && !find_default_scene(file_to_load_from)) {
+        cout << "Error: No scene given and scene/env.json not found" << endl;
+        return -1;
+    }
+
+    HeadlessScene scene;
+    if (!scene.load(file_to_load_from, fp, seed)) {
+        return -1;
+    }
+    const FlockParameters& ranges = scene.fp;
+    Flock& flock = scene.flock;
+    flock.buildGrid();
+    for (int i = 0; i < num_steps; i++) {
+        scene.step(false);
+    }
+    flock.incremental_grid = false;
+    flock.build_neighbour_grid(max(max(ranges.coherence, ranges.alignment), ranges.separation));
+
+    size_t num = flock.state.size();
+    vector<PointMassBird> birds(num);
+    double visits = 0;
+    for (size_t i = 0; i < num; i++) {
+        PointMassBird& bird = birds[i];
+        const BirdColdState& cold = flock.state.cold[i];
+        const BirdSpecies& species = flock.state.speciesOf(i);
+        bird.pinned = false;
+        bird.start_position = cold.start_position;
+        bird.position = flock.state.position(i);
+        bird.last_position = cold.last_position;
+        bird.halfedge = nullptr;
+        bird.speed = flock.state.speed(i);
+        bird.cumulatedSpeed = flock.state.steering(i);
+        bird.minSpeed = species.minSpeed;
+        bird.maxSpeed = species.maxSpeed;
+        bird.maxAcc = species.maxAcc;
+        bird.minAcc = species.minAcc;
+        bird.rand_stop_pos = cold.rand_stop_pos;
+        bird.able_stop = cold.able_stop;
+        bird.branch = cold.branch;
+        bird.timer = cold.timer;
+        flock.neighbour_grid.queryRuns(bird.position, [&](const int*, int count) { visits += count; });
+    }
+
+    double checksums[3];
+    double old_seconds = timePointMass(flock, birds, ranges, passes, checksums[0]);
+    double scalar_seconds = timeFlockState(flock, ranges, STEERING_KERNEL_SCALAR, passes, checksums[1]);
+    double simd_seconds = timeFlockState(flock, ranges, steeringKernelType(), passes, checksums[2]);
+    // Positions and speeds are 3 floats each. Birds of a grid run sit next
+    // to each other, so a visit reads little more than these.
+    size_t state_visit_bytes = 6 * sizeof(float);
+    size_t state_bird_bytes = 9 * sizeof(float);
+
+    printf("Flock:   %zu birds after %d steps, %.1f neighbour visits a bird, best of %d passes\n", num, num_steps,
+           visits / num, passes);
+    printf("Layout:                     bytes a bird | read a visit | read a pass | ns per bird-step\n");
+    printf("  vector<PointMass>                 %4zu |       %6.1f | %8.1f MB | %8.1f\n", sizeof(PointMassBird),
+           pointMassVisitBytes(), visits * pointMassVisitBytes() / 1e6, old_seconds * 1e9 / num);
+    printf("  FlockState, scalar kernel         %4zu |       %6zu | %8.1f MB | %8.1f (%.2fx)\n", state_bird_bytes,
+           state_visit_bytes, visits * state_visit_bytes / 1e6, scalar_seconds * 1e9 / num,
+           old_seconds / scalar_seconds);
+    printf("  FlockState, %-6s kernel         %4zu |       %6zu | %8.1f MB | %8.1f (%.2fx)\n",
+           steeringKernelName(steeringKernelType()), state_bird_bytes, state_visit_bytes,
+           visits * state_visit_bytes / 1e6, simd_seconds * 1e9 / num, old_seconds / simd_seconds);
+    printf("         checksums %.6g, %.6g and %.6g\n", checksums[0], checksums[1], checksums[2]);
+    return 0;
+}
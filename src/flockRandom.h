@@ -0,0 +1,60 @@
+#ifndef FLOCK_RANDOM_H
+#define FLOCK_RANDOM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Counter-based random numbers for the flock.
+//
+// A draw is a pure function of (seed, bird, step, slot): there is no
+// generator state to share, lock or advance, so birds can draw in any
+// order and on any thread and a run is reproducible from its seed alone.
+// `slot` tells apart the different draws one bird makes in one step.
+//
+// The hash chains SplitMix64's finalizer over the four keys. It is all
+// integer multiplies, shifts and xors, so loops over birds vectorize.
+struct FlockRandom {
+  FlockRandom(uint64_t seed = 0) : seed(seed) {}
+
+  static inline uint64_t mix(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // 64 random bits.
+  uint64_t bits(uint64_t bird, uint64_t step, uint32_t slot) const {
+    uint64_t h = mix(seed ^ ((uint64_t)slot << 32));
+    h = mix(h ^ bird);
+    return mix(h ^ step);
+  }
+
+  // Uniform in [0, 1).
+  double uniform(uint64_t bird, uint64_t step, uint32_t slot) const {
+    return (bits(bird, step, slot) >> 11) * (1. / 9007199254740992.);
+  }
+
+  // Uniform in [lo, hi).
+  double uniform(double lo, double hi, uint64_t bird, uint64_t step, uint32_t slot) const {
+    return lo + (hi - lo) * uniform(bird, step, slot);
+  }
+
+  // Uniform in [0, n).
+  int uniformInt(int n, uint64_t bird, uint64_t step, uint32_t slot) const {
+    return (int)(bits(bird, step, slot) % (uint64_t)n);
+  }
+
+  // out[k] = uniform(lo, hi, first_bird + k, step, slot) for a whole batch of
+  // birds at once.
+  void fill(float *out, size_t count, float lo, float hi,
+            uint64_t first_bird, uint64_t step, uint32_t slot) const {
+    for (size_t k = 0; k < count; k++) {
+      out[k] = (float)uniform(lo, hi, first_bird + k, step, slot);
+    }
+  }
+
+  uint64_t seed;
+};
+
+#endif /* FLOCK_RANDOM_H */
@@ -1,4 +1,6 @@
+#include <chrono>
 #include <cmath>
+#include <fstream>
 #include <glad/glad.h>
 
 
@@ -10,191 +12,136 @@
 
 #include "camera.h"
 #include "flock.h"
+#include "flockCheckpoint.h"
+#include "imageLoader.h"
 #include "misc/camera_info.h"
+#include "misc/embedded_resources.h"
 #include "misc/file_utils.h"
-// Needed to generate stb_image binaries. Should only define in exactly one source file importing stb_image.h.
-#define STB_IMAGE_IMPLEMENTATION
-#include "misc/stb_image.h"
-
+#include "misc/timeline.h"
+#include "objLoader.h"
 #include "collision/sphere.h"
 
 using namespace nanogui;
 using namespace std;
 
-Vector3D load_texture(int frame_idx, GLuint handle, const char* where) {
-  Vector3D size_retval;
-
-  if (strlen(where) == 0) return size_retval;
-
-  glActiveTexture(GL_TEXTURE0 + frame_idx);
-  glBindTexture(GL_TEXTURE_2D, handle);
-
-
-  int img_x, img_y, img_n;
-  unsigned char* img_data = stbi_load(where, &img_x, &img_y, &img_n, 3);
-  size_retval.x = img_x;
-  size_retval.y = img_y;
-  size_retval.z = img_n;
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, img_x, img_y, 0, GL_RGB, GL_UNSIGNED_BYTE, img_data);
-  stbi_image_free(img_data);
-
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-  return size_retval;
+// Units 1 to 4 are the 2D textures, the cube faces go to unit 5 in the order
+// of GL_TEXTURE_CUBE_MAP_POSITIVE_X onwards.
+const char *const FlockSimulator::TEXTURE_PATHS[NUM_TEXTURES] = {
+  "textures/texture_1.png",
+  "textures/texture_2.png",
+  "textures/texture_3.png",
+  "textures/texture_4.png",
+  "textures/cube/posx.jpg",
+  "textures/cube/negx.jpg",
+  "textures/cube/posy.jpg",
+  "textures/cube/negy.jpg",
+  "textures/cube/posz.jpg",
+  "textures/cube/negz.jpg"
+};
+
+std::unique_ptr<ImageLoader> FlockSimulator::decodeTextures(const std::string &project_root, Timeline *timeline) {
+  std::vector<std::string> filenames;
+  for (int i = 0; i < NUM_TEXTURES; ++i) {
+    if (!EmbeddedResources::findImage(TEXTURE_PATHS[i])) {
+      filenames.push_back(project_root + "/" + TEXTURE_PATHS[i]);
+    }
+  }
+  return std::unique_ptr<ImageLoader>(new ImageLoader(filenames, 0, timeline));
 }
 
-
-
-
-
-void load_cubemap(int frame_idx, GLuint handle, const std::vector<std::string>& file_locs) {
-  glActiveTexture(GL_TEXTURE0 + frame_idx);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, handle);
-  for (int side_idx = 0; side_idx < 6; ++side_idx) {
-
-    int img_x, img_y, img_n;
-    unsigned char* img_data = stbi_load(file_locs[side_idx].c_str(), &img_x, &img_y, &img_n, 3);
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side_idx, 0, GL_RGB, img_x, img_y, 0, GL_RGB, GL_UNSIGNED_BYTE, img_data);
-    stbi_image_free(img_data);
-    std::cout << "Side " << side_idx << " has dimensions " << img_x << ", " << img_y << std::endl;
-
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+// Text of a file under the project root: baked into the binary, or read.
+static std::string load_text(const std::string &project_root, const std::string &path) {
+  const EmbeddedResources::Text *baked = EmbeddedResources::findText(path);
+  if (baked) {
+    return std::string(baked->text, baked->size);
   }
+  std::ifstream file(project_root + "/" + path);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
 }
 
-bool FlockSimulator::loadOBJ(const char* path,
-    std::vector < Vector3D >& out_vertices,
-    std::vector < Vector2D >& out_uvs,
-    std::vector < Vector3D >& out_normals
-) {
-
-
-    std::vector< unsigned int > vertexIndices, uvIndices, normalIndices;
-    std::vector< Vector3D > temp_vertices;
-    std::vector< Vector2D > temp_uvs;
-    std::vector< Vector3D > temp_normals;
-
-    FILE* file = fopen(path, "r");
-    if (file == NULL) {
-        printf("Impossible to open the file !\n");
-        return false;
-    }
-
-
-    while (1) {
-
-        char lineHeader[128];
-        // read the first word of the line
-        int res = fscanf(file, "%s", lineHeader);
-        if (res == EOF)
-            break; // EOF = End Of File. Quit the loop.
-        // else : parse lineHeader
-
-        if (strcmp(lineHeader, "v") == 0) {
-
-            Vector3D vertex;
-            fscanf(file, " %lf %lf %lf\n", &vertex.x, &vertex.y, &vertex.z);
-            temp_vertices.push_back(vertex);
-
-        }
-        else if (strcmp(lineHeader, "vt") == 0) {
-            Vector2D uv;
-            fscanf(file, "%lf %lf\n", &uv.x, &uv.y);
-            uv.y = 1.0 - uv.y;
-            temp_uvs.push_back(uv);
-        }
-        else if (strcmp(lineHeader, "vn") == 0) {
-            Vector3D normal;
-            fscanf(file, "%lf %lf %lf\n", &normal.x, &normal.y, &normal.z);
-            temp_normals.push_back(normal);
-        }
-        else if (strcmp(lineHeader, "f") == 0) {
-            std::string vertex1, vertex2, vertex3;
-            unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-            int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
-            if (matches != 9) {
-                printf("File can't be read by our simple parser : ( Try exporting with other options\n");
-                return false;
-            }
-            vertexIndices.push_back(vertexIndex[0]);
-            vertexIndices.push_back(vertexIndex[1]);
-            vertexIndices.push_back(vertexIndex[2]);
-            uvIndices.push_back(uvIndex[0]);
-            uvIndices.push_back(uvIndex[1]);
-            uvIndices.push_back(uvIndex[2]);
-            normalIndices.push_back(normalIndex[0]);
-            normalIndices.push_back(normalIndex[1]);
-            normalIndices.push_back(normalIndex[2]);
-        }
-    }
-
-    for (unsigned int i = 0; i < vertexIndices.size(); i++) {
-        unsigned int vertexIndex = vertexIndices[i];
-        Vector3D vertex = temp_vertices[vertexIndex - 1];
-        out_vertices.push_back(vertex);
-    }
-    for (unsigned int i = 0; i < normalIndices.size(); i++) {
-
-        unsigned int normalIndex = normalIndices[i];
-        Vector3D normal = temp_normals[normalIndex - 1];
-        out_normals.push_back(normal);
-    }
-
-    for (unsigned int i = 0; i < uvIndices.size(); i++) {
-        unsigned int uvIndex = uvIndices[i];
-        Vector2D uv = temp_uvs[uvIndex - 1];
-        out_uvs.push_back(uv);
-    }
-    std::cout << "end" << endl;
-    return true;
+void FlockSimulator::uploadTexture(int index, int width, int height, int channels, const unsigned char *pixels) {
+  if (index < 4) {
+    GLuint handles[4] = {m_gl_texture_1, m_gl_texture_2, m_gl_texture_3, m_gl_texture_4};
+    Vector3D *sizes[4] = {&m_gl_texture_1_size, &m_gl_texture_2_size, &m_gl_texture_3_size, &m_gl_texture_4_size};
+    *sizes[index] = Vector3D(width, height, channels);
+
+    glActiveTexture(GL_TEXTURE1 + index);
+    glBindTexture(GL_TEXTURE_2D, handles[index]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    std::cout << "Texture " << index + 1 << " loaded with size: " << *sizes[index] << std::endl;
+  } else {
+    int side_idx = index - 4;
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_gl_cubemap_tex);
+    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side_idx, 0, GL_RGB, width, height, 0, GL_RGB,
+                 GL_UNSIGNED_BYTE, pixels);
+    std::cout << "Side " << side_idx << " has dimensions " << width << ", " << height << std::endl;
+  }
 }
+
 // TODO: change texture files and load them in this function.
-void FlockSimulator::load_textures() {
+void FlockSimulator::load_textures(ImageLoader *textures, Timeline *timeline) {
   glGenTextures(1, &m_gl_texture_1);
   glGenTextures(1, &m_gl_texture_2);
   glGenTextures(1, &m_gl_texture_3);
   glGenTextures(1, &m_gl_texture_4);
   glGenTextures(1, &m_gl_cubemap_tex);
 
-  m_gl_texture_1_size = load_texture(1, m_gl_texture_1, (m_project_root + "/textures/texture_1.png").c_str());
-  m_gl_texture_2_size = load_texture(2, m_gl_texture_2, (m_project_root + "/textures/texture_2.png").c_str());
-  m_gl_texture_3_size = load_texture(3, m_gl_texture_3, (m_project_root + "/textures/texture_3.png").c_str());
-  m_gl_texture_4_size = load_texture(4, m_gl_texture_4, (m_project_root + "/textures/texture_4.png").c_str());
-
-  std::cout << "Texture 1 loaded with size: " << m_gl_texture_1_size << std::endl;
-  std::cout << "Texture 2 loaded with size: " << m_gl_texture_2_size << std::endl;
-  std::cout << "Texture 3 loaded with size: " << m_gl_texture_3_size << std::endl;
-  std::cout << "Texture 4 loaded with size: " << m_gl_texture_4_size << std::endl;
-
-  std::vector<std::string> cubemap_fnames = {
-    m_project_root + "/textures/cube/posx.jpg",
-    m_project_root + "/textures/cube/negx.jpg",
-    m_project_root + "/textures/cube/posy.jpg",
-    m_project_root + "/textures/cube/negy.jpg",
-    m_project_root + "/textures/cube/posz.jpg",
-    m_project_root + "/textures/cube/negz.jpg"
-  };
-
-  load_cubemap(5, m_gl_cubemap_tex, cubemap_fnames);
+  glActiveTexture(GL_TEXTURE5);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, m_gl_cubemap_tex);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+  // baked ones are ready, the rest are uploaded as the loader finishes them
+  std::vector<int> decoded;
+  for (int i = 0; i < NUM_TEXTURES; ++i) {
+    const EmbeddedResources::Image *baked = EmbeddedResources::findImage(TEXTURE_PATHS[i]);
+    if (baked) {
+      uploadTexture(i, baked->width, baked->height, baked->channels, baked->pixels);
+    } else {
+      decoded.push_back(i);
+    }
+  }
+
+  std::unique_ptr<ImageLoader> own_textures;
+  if (!textures) {
+    own_textures = decodeTextures(m_project_root, timeline);
+    textures = own_textures.get();
+  }
+  std::unique_ptr<RGBImage> image;
+  size_t loader_idx;
+  while (textures->next(image, loader_idx)) {
+    int i = decoded[loader_idx];
+    uploadTexture(i, image->width, image->height, image->channels, image->pixels);
+    if (timeline) {
+      timeline->mark(std::string("uploaded ") + TEXTURE_PATHS[i]);
+    }
+  }
   std::cout << "Loaded cubemap texture" << std::endl;
 }
 
 // TODO: change shaders
 void FlockSimulator::load_shaders() {
+  shader_cache.reset(new ShaderCache(m_project_root + "/shader_cache"));
+
   std::set<std::string> shader_folder_contents;
-  bool success = FileUtils::list_files_in_directory(m_project_root + "/shaders", shader_folder_contents);
-  if (!success) {
+  if (EmbeddedResources::baked()) {
+    std::vector<std::string> baked = EmbeddedResources::listTexts("shaders");
+    shader_folder_contents.insert(baked.begin(), baked.end());
+  } else if (!FileUtils::list_files_in_directory(m_project_root + "/shaders", shader_folder_contents)) {
     std::cout << "Error: Could not find the shaders folder!" << std::endl;
   }
 
-  std::string std_vert_shader = m_project_root + "/shaders/Default.vert";
+  std::string std_vert_shader = load_text(m_project_root, "shaders/Default.vert");
+  std::string bird_vert_shader = load_text(m_project_root, "shaders/Bird.vert");
 
   for (const std::string& shader_fname : shader_folder_contents) {
     std::string file_extension;
@@ -211,14 +158,10 @@ void FlockSimulator::load_shaders() {
 
     // Check if there is a proper .vert shader or not for it
     std::string vert_shader = std_vert_shader;
-    std::string associated_vert_shader_path = m_project_root + "/shaders/" + shader_name + ".vert";
-    if (FileUtils::file_exists(associated_vert_shader_path)) {
-      vert_shader = associated_vert_shader_path;
+    if (shader_folder_contents.count(shader_name + ".vert")) {
+      vert_shader = load_text(m_project_root, "shaders/" + shader_name + ".vert");
     }
-
-    std::shared_ptr<GLShader> nanogui_shader = make_shared<GLShader>();
-    nanogui_shader->initFromFiles(shader_name, vert_shader,
-                                  m_project_root + "/shaders/" + shader_fname);
+    std::string frag_shader = load_text(m_project_root, "shaders/" + shader_fname);
 
     // Special filenames are treated a bit differently
     ShaderTypeHint hint;
@@ -233,7 +176,7 @@ void FlockSimulator::load_shaders() {
       std::cout << "Type: Custom" << std::endl;
     }
 
-    UserShader user_shader(shader_name, nanogui_shader, hint);
+    UserShader user_shader(shader_name, vert_shader, bird_vert_shader, frag_shader, hint);
 
     shaders.push_back(user_shader);
     shaders_combobox_names.push_back(shader_name);
@@ -249,20 +192,67 @@ void FlockSimulator::load_shaders() {
 }
 
 
-FlockSimulator::FlockSimulator(std::string project_root, Screen *screen)
-: m_project_root(project_root) {
+// Programs are linked on first use, from the cache when it has them, so
+// starting up builds the two the first frame needs rather than all of them.
+// Each link is marked on the startup timeline with how long it took.
+static std::shared_ptr<GLShader> linkShader(const std::string &name, const std::string &vert_shader,
+                                            const std::string &frag_shader, ShaderCache *cache,
+                                            Timeline *timeline) {
+  auto start = std::chrono::steady_clock::now();
+  int hits = cache->hits;
+  std::shared_ptr<CachedShader> shader = make_shared<CachedShader>();
+  shader->init(name, vert_shader, frag_shader, cache);
+  if (timeline) {
+    char ms[32];
+    snprintf(ms, sizeof(ms), "%.1f ms",
+             std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    timeline->mark("shader " + name + (cache->hits > hits ? " loaded from the cache in " : " compiled in ") + ms);
+  }
+  return shader;
+}
+
+GLShader &FlockSimulator::sceneShader(UserShader &user_shader) {
+  if (!user_shader.nanogui_shader) {
+    user_shader.nanogui_shader =
+        linkShader(user_shader.display_name, user_shader.vert_shader, user_shader.frag_shader, shader_cache.get(),
+                   timeline);
+  }
+  return *user_shader.nanogui_shader;
+}
+
+GLShader &FlockSimulator::birdShader(UserShader &user_shader) {
+  if (!user_shader.bird_shader) {
+    user_shader.bird_shader = linkShader(user_shader.display_name + " (birds)", user_shader.bird_vert_shader,
+                                         user_shader.frag_shader, shader_cache.get(), timeline);
+    if (bird_mesh_vbo) {
+      pointBirdMesh(*user_shader.bird_shader);
+    }
+    bird_instances_generation = -1; // point its vertex array at them too
+  }
+  return *user_shader.bird_shader;
+}
+
+FlockSimulator::FlockSimulator(std::string project_root, Screen *screen, ImageLoader *textures, Timeline *timeline)
+: m_project_root(project_root), timeline(timeline) {
   this->screen = screen;
 
+  // read while the textures are still decoding, compiled when first drawn
   this->load_shaders();
-  this->load_textures();
-
-  std::vector< Vector3D > vertices;
-  std::vector< Vector2D > uvs;
-  std::vector< Vector3D > normals; // Won't be used at the moment.
-  bool res = loadOBJ("../../../model/bird3.obj", vertices, uvs, normals);
-  this->bd_vertices = vertices;
-  this->bd_uvs = uvs;
-  this->bd_normals = normals;
+  if (timeline) {
+    timeline->mark("shaders read");
+  }
+  this->load_textures(textures, timeline);
+
+  const EmbeddedResources::Mesh *baked_mesh = EmbeddedResources::findMesh("model/bird3.obj");
+  if (baked_mesh) {
+    uploadBirdMesh(baked_mesh->vertices, baked_mesh->num_vertices, baked_mesh->indices, baked_mesh->num_indices);
+  } else {
+    // parsed once, then read from the model's .meshbin cache
+    IndexedMesh bird_mesh;
+    loadMesh(m_project_root + "/model/bird3.obj", bird_mesh);
+    std::vector<float> vertices = bird_mesh.interleaved();
+    uploadBirdMesh(vertices.data(), bird_mesh.numVertices(), bird_mesh.indices.data(), bird_mesh.indices.size());
+  }
 
   glEnable(GL_PROGRAM_POINT_SIZE);
   glEnable(GL_DEPTH_TEST);
@@ -271,8 +261,15 @@ FlockSimulator::FlockSimulator(std::string project_root, Screen *screen)
 
 FlockSimulator::~FlockSimulator() {
   for (auto shader : shaders) {
-    shader.nanogui_shader->free();
+    if (shader.nanogui_shader) {
+      shader.nanogui_shader->free();
+    }
+    if (shader.bird_shader) {
+      shader.bird_shader->free();
+    }
   }
+  glDeleteBuffers(1, &bird_mesh_vbo);
+  glDeleteBuffers(1, &bird_mesh_ebo);
   glDeleteTextures(1, &m_gl_texture_1);
   glDeleteTextures(1, &m_gl_texture_2);
   glDeleteTextures(1, &m_gl_texture_3);
@@ -312,8 +309,8 @@ void FlockSimulator::init() {
 
   Vector3D avg_bd_position(0, 0, 0);
 
-  for (auto &bd : flock->point_masses) {
-    avg_bd_position += bd.position / flock->point_masses.size();
+  for (int i = 0; i < flock->state.size(); i++) {
+    avg_bd_position += flock->state.position(i) / flock->state.size();
   }
 
   CGL::Vector3D target(avg_bd_position.x, avg_bd_position.y / 2,
@@ -345,6 +342,20 @@ bool FlockSimulator::isAlive() { return is_alive; }
 void FlockSimulator::drawContents() {
   glEnable(GL_DEPTH_TEST);
 
+  auto now = std::chrono::steady_clock::now();
+  if (frames >= 0) {
+    frame_seconds += std::chrono::duration<double>(now - last_frame).count();
+  }
+  last_frame = now;
+  if (++frames == TIMING_FRAMES) {
+    char caption[64];
+    snprintf(caption, sizeof(caption), "frame %.3f ms, %d birds", frame_seconds * 1e3 / frames,
+             (int)flock->state.size());
+    frame_label->setCaption(caption);
+    frame_seconds = 0;
+    frames = 0;
+  }
+
 
 
   if (!is_paused) {
@@ -358,9 +369,10 @@ void FlockSimulator::drawContents() {
 
   // Bind the active shader
 
-  const UserShader& active_shader = shaders[active_shader_idx];
+  UserShader& active_shader = shaders[active_shader_idx];
 
-  GLShader &shader = *active_shader.nanogui_shader;
+  // only the birds use the active shader
+  GLShader &shader = birdShader(active_shader);
   shader.bind();
 
   // Prepare the camera projection matrix
@@ -410,8 +422,8 @@ void FlockSimulator::drawContents() {
     break;
   }
 
-  const UserShader &active_shader2 = shaders[5]; // normal shader
-  GLShader &shabi = *active_shader2.nanogui_shader;
+  UserShader &active_shader2 = shaders[5]; // normal shader
+  GLShader &shabi = sceneShader(active_shader2);
   shabi.bind();
   
   shabi.setUniform("u_model", model);
@@ -421,68 +433,111 @@ void FlockSimulator::drawContents() {
     co->render(shabi);
   }
 }
-Matrix3x3 rotation_between_vectors_to_matrix(const Vector3D v1, const Vector3D v2)
-{
-    Matrix3x3 m1, m2;
-
-    Vector3D axis = cross(v1, v2);
-    axis.normalize();
-
-    /* construct 2 matrices */
-    m1[0] = v1;
-    m2[0] = v2;
-
-    m1[1] = axis;
-    m2[1] = axis;
-
-    m1[2] = cross(m1[1], m1[0]);
-    m2[2] = cross(m2[1], m2[0]);
-
-    /* calculate the difference between m1 and m2 */
-    m1 = m1.T();
-
-    Matrix3x3 matrix = m2 * m1;
-
-    return matrix;
+// Points the attribute, if the shader uses it, at floats of the bound buffer.
+static void birdAttrib(GLShader &shader, const char *name, int size, int stride, int offset, int divisor) {
+  GLint attrib = shader.attrib(name, false);
+  if (attrib < 0) {
+    return;
+  }
+  glEnableVertexAttribArray(attrib);
+  glVertexAttribPointer(attrib, size, GL_FLOAT, GL_FALSE, stride * sizeof(float),
+                        (const void *)(offset * sizeof(float)));
+  glVertexAttribDivisor(attrib, divisor);
 }
 
+void FlockSimulator::uploadBirdMesh(const float *vertices, int num_vertices, const uint32_t *indices,
+                                    int num_indices) {
+  bird_index_count = num_indices;
+  glGenBuffers(1, &bird_mesh_vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, bird_mesh_vbo);
+  glBufferData(GL_ARRAY_BUFFER, num_vertices * 8 * sizeof(float), vertices, GL_STATIC_DRAW);
+  // filled through GL_ARRAY_BUFFER, as no vertex array may be bound yet
+  glGenBuffers(1, &bird_mesh_ebo);
+  glBindBuffer(GL_ARRAY_BUFFER, bird_mesh_ebo);
+  glBufferData(GL_ARRAY_BUFFER, num_indices * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+
+  for (UserShader &user_shader : shaders) {
+    if (user_shader.bird_shader) {
+      pointBirdMesh(*user_shader.bird_shader);
+    }
+  }
+}
 
-void FlockSimulator::drawBird(PointMass &pm, GLShader &shader, ShaderTypeHint stype) {
-    int num_springs = bd_vertices.size();
-    double smaller = 0.02;
-
-
-    MatrixXf positions(4, num_springs);
-    MatrixXf normalsmat(4, num_springs);
-    MatrixXf uvs(2, num_springs);
-    MatrixXf tangents(4, num_springs);
-    Vector3D pa = pm.position;
-    Vector3D na = Vector3D();
+// The attribute layout and the index buffer live in the vertex array of
+// each bird shader.
+void FlockSimulator::pointBirdMesh(GLShader &shader) {
+  shader.bind();
+  glBindBuffer(GL_ARRAY_BUFFER, bird_mesh_vbo);
+  birdAttrib(shader, "in_position", 3, 8, 0, 0);
+  birdAttrib(shader, "in_normal", 3, 8, 3, 0);
+  birdAttrib(shader, "in_uv", 2, 8, 6, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bird_mesh_ebo);
+}
 
-    Matrix3x3 rotate = rotation_between_vectors_to_matrix(Vector3D(0, 0, -1), pm.speed / pm.speed.norm());
-    for (int si = 0; si < num_springs; si++) {
-        Vector3D pos = pa + rotate * bd_vertices[si] * smaller;
-        Vector3D norm = na + rotate * bd_normals[si] * smaller;
-        Vector2D uv = bd_uvs[si];
-        positions.col(si) << pos.x, pos.y, pos.z, 1.0;
-        normalsmat.col(si) << norm.x, norm.y, norm.z, 0.0;
-        uvs.col(si) << uv.x, uv.y;
-        tangents.col(si) << 1.0, 0.0, 0.0, 1.0;
+void FlockSimulator::pointBirdInstances() {
+  for (UserShader &user_shader : shaders) {
+    if (!user_shader.bird_shader) {
+      continue;
     }
+    GLShader &shader = *user_shader.bird_shader;
+    shader.bind();
+    glBindBuffer(GL_ARRAY_BUFFER, bird_instances.buffer());
+    birdAttrib(shader, "in_bird_position", 3, 6, 0, 1);
+    birdAttrib(shader, "in_bird_direction", 3, 6, 3, 1);
+  }
+  bird_instances_generation = bird_instances.generation;
+}
 
-    shader.setUniform("u_color", nanogui::Color(165.0, 42.0, 42.0, 1.0f), false);
-    shader.uploadAttrib("in_position", positions, false);
-    if (stype == NORMALS) {
-        shader.uploadAttrib("in_normal", normalsmat, false);
-    }
-    else if (stype == PHONG) {
-        shader.uploadAttrib("in_normal", normalsmat, false);
-        shader.uploadAttrib("in_uv", uvs, false);
-        shader.uploadAttrib("in_tangent", tangents, false);
-    }
+void FlockSimulator::drawBirds(GLShader &shader) {
+  const FlockState &state = flock->state;
+  int num_birds = state.size();
+  if (num_birds == 0) {
+    return;
+  }
 
-    shader.drawArray(GL_TRIANGLES, 0, num_springs);
+  auto start = std::chrono::steady_clock::now();
+  // written in place, straight from the flock
+  float *instances = bird_instances.map(num_birds);
+  #pragma omp parallel for
+  for (int i = 0; i < num_birds; i++) {
+    float *instance = instances + i * 6;
+    float speed = sqrt(state.vx[i] * state.vx[i] + state.vy[i] * state.vy[i] + state.vz[i] * state.vz[i]);
+    float inv_speed = speed > 0 ? 1 / speed : 0;
+    instance[0] = state.px[i];
+    instance[1] = state.py[i];
+    instance[2] = state.pz[i];
+    instance[3] = state.vx[i] * inv_speed;
+    instance[4] = state.vy[i] * inv_speed;
+    instance[5] = speed > 0 ? state.vz[i] * inv_speed : -1;
+  }
+  bird_instances.unmap();
+  upload_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (++upload_frames == TIMING_FRAMES) {
+    char caption[64];
+    snprintf(caption, sizeof(caption), "upload %.3f ms/frame (%s)", upload_seconds * 1e3 / upload_frames,
+             bird_instances.isPersistent() ? "persistent ring" : "orphaning");
+    upload_label->setCaption(caption);
+    upload_seconds = 0;
+    upload_frames = 0;
+  }
 
+  if (bird_instances.generation != bird_instances_generation) {
+    pointBirdInstances();
+    shader.bind();
+  }
+  shader.setUniform("u_color", nanogui::Color(165.0, 42.0, 42.0, 1.0f), false);
+  shader.setUniform("u_bird_scale", bird_scale, false);
+  GLint tangent = shader.attrib("in_tangent", false);
+  if (tangent >= 0) {
+    glVertexAttrib4f(tangent, 1, 0, 0, 1);
+  }
+  if (bird_instances.isPersistent()) {
+    glDrawElementsInstancedBaseInstance(GL_TRIANGLES, bird_index_count, GL_UNSIGNED_INT, 0, num_birds,
+                                        bird_instances.baseInstance());
+  } else {
+    glDrawElementsInstanced(GL_TRIANGLES, bird_index_count, GL_UNSIGNED_INT, 0, num_birds);
+  }
+  bird_instances.fence();
 }
 
 void FlockSimulator::drawWireframe(GLShader &shader) {
@@ -614,10 +669,7 @@ void FlockSimulator::drawWireframe(GLShader &shader) {
   //}
 
 
-    for (int i = 0; i < flock->point_masses.size(); i++) {
-        PointMass pm = (flock->point_masses[i]);
-        drawBird(pm, shader, WIREFRAME);
-    }
+    drawBirds(shader);
 
 
     /*for (int i = 0; i += 1; i < vertices.size()) {
@@ -657,10 +709,7 @@ void FlockSimulator::drawNormals(GLShader &shader) {
   //  normals.col(i * 3 + 2) << n3.x, n3.y, n3.z, 0.0;
   //}
 
-    for (int i = 0; i < flock->point_masses.size(); i++) {
-        PointMass pm = (flock->point_masses[i]);
-        drawBird(pm, shader, NORMALS);
-    }
+    drawBirds(shader);
 
     //int sphere_num_lat = 10;
     //int sphere_num_lon = 10;
@@ -685,10 +734,7 @@ void FlockSimulator::drawNormals(GLShader &shader) {
 
 void FlockSimulator::drawPhong(GLShader &shader) {
 
-    for (int i = 0; i < flock->point_masses.size(); i++) {
-        PointMass pm = (flock->point_masses[i]);
-        drawBird(pm, shader, PHONG);
-    }
+    drawBirds(shader);
   //  int sphere_num_lat = 10;
   //  int sphere_num_lon = 10;
   //  Vector3D origin;
@@ -879,12 +925,48 @@ bool FlockSimulator::keyCallbackEvent(int key, int scancode, int action,
       is_stopped = !is_stopped;
       flock->set_stop(is_stopped);
       break;
+    case 'k':
+    case 'K':
+      checkpointFlock();
+      break;
+    case 'l':
+    case 'L':
+      restoreFlock();
+      break;
     }
   }
 
   return true;
 }
 
+bool FlockSimulator::checkpointFlock() {
+  auto start = std::chrono::steady_clock::now();
+  if (!saveCheckpoint(checkpoint_path, *flock, *fp)) {
+    return false;
+  }
+  std::cout << "Saved " << flock->state.size() << " birds to " << checkpoint_path << " in "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms"
+            << std::endl;
+  return true;
+}
+
+bool FlockSimulator::restoreFlock() {
+  auto start = std::chrono::steady_clock::now();
+  if (!loadCheckpoint(checkpoint_path, *flock, *fp)) {
+    return false;
+  }
+  std::cout << "Restored " << flock->state.size() << " birds from " << checkpoint_path << " in "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms"
+            << std::endl;
+  if (coherence_box) {
+    coherence_box->setValue(fp->coherence);
+    alignment_box->setValue(fp->alignment);
+    separation_box->setValue(fp->separation);
+    num_birds_box->setValue(fp->num_birds);
+  }
+  return true;
+}
+
 bool FlockSimulator::dropCallbackEvent(int count, const char **filenames) {
   return true;
 }
@@ -965,6 +1047,7 @@ void FlockSimulator::initGUI(Screen *screen) {
     fb->setMinValue(0);
     fb->setMaxValue(max_para);
     fb->setCallback([this, max_para](float value) { fp->coherence = min(value, max_para); });
+    coherence_box = fb;
 
     new Label(panel, "alignment :", "sans-bold");
 
@@ -979,6 +1062,7 @@ void FlockSimulator::initGUI(Screen *screen) {
     fb->setMinValue(0);
     fb->setMaxValue(max_para);
     fb->setCallback([this, max_para](float value) { fp->alignment = min(value, max_para); });
+    alignment_box = fb;
 
     new Label(panel, "separation :", "sans-bold");
 
@@ -993,6 +1077,7 @@ void FlockSimulator::initGUI(Screen *screen) {
     fb->setMinValue(0);
     fb->setMaxValue(max_para);
     fb->setCallback([this, max_para](float value) { fp->separation = min(value, max_para); });
+    separation_box = fb;
 
     new Label(panel, "Number of Birds :", "sans-bold");
 
@@ -1005,6 +1090,29 @@ void FlockSimulator::initGUI(Screen *screen) {
     ib->setSpinnable(true);
     ib->setMinValue(2);
     ib->setCallback([this](int value) { fp->num_birds = value; });
+    num_birds_box = ib;
+
+    // 0 is exact; larger values approximate more far birds by their centroid
+    new Label(panel, "octree theta :", "sans-bold");
+
+    fb = new FloatBox<double>(panel);
+    fb->setEditable(true);
+    fb->setFixedSize(Vector2i(100, 20));
+    fb->setFontSize(14);
+    fb->setValue(flock->octree_theta);
+    fb->setUnits(" ");
+    fb->setSpinnable(true);
+    fb->setMinValue(0);
+    fb->setMaxValue(2);
+    fb->setCallback([this](float value) { flock->octree_theta = max(value, 0.f); });
+  }
+
+  {
+    Button *b = new Button(window, "octree");
+    b->setFlags(Button::ToggleButton);
+    b->setPushed(flock->octree_mode);
+    b->setFontSize(14);
+    b->setChangeCallback([this](bool state) { flock->octree_mode = state; });
   }
 
    //Simulation constants
@@ -1323,4 +1431,14 @@ void FlockSimulator::initGUI(Screen *screen) {
     fb->setSpinnable(true);
     fb->setCallback([this](float value) { this->m_height_scaling = value; });
   }*/
+
+  // Below the Appearance window, which has the top left corner
+  int appearance_bottom = window->position().y() + window->preferredSize(screen->nvgContext()).y();
+  window = new Window(screen, "Timing");
+  window->setPosition(Vector2i(15, appearance_bottom + 15));
+  window->setLayout(new GroupLayout(15, 6, 14, 5));
+  new Label(window, "Frames", "sans-bold");
+  frame_label = new Label(window, "frame -", "sans");
+  new Label(window, "Bird instances", "sans-bold");
+  upload_label = new Label(window, "upload -", "sans");
 }
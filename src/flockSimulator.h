@@ -2,27 +2,45 @@
 #define CGL_CLOTH_SIMULATOR_H
 
 #include <nanogui/nanogui.h>
+#include <chrono>
 #include <memory>
 
 #include "camera.h"
 #include "flock.h"
+#include "instanceRing.h"
+#include "shaderCache.h"
 
 
 using namespace nanogui;
 
+class ImageLoader;
+class Timeline;
 struct UserShader;
 enum ShaderTypeHint { WIREFRAME = 0, NORMALS = 1, PHONG = 2 };
 
 class FlockSimulator {
 public:
-  FlockSimulator(std::string project_root, Screen *screen);
+  // Textures come from `textures` when given, see decodeTextures, else the
+  // simulator starts decoding them itself.
+  FlockSimulator(std::string project_root, Screen *screen, ImageLoader *textures = nullptr,
+                 Timeline *timeline = nullptr);
   ~FlockSimulator();
 
+  // Starts decoding the textures not baked into the binary on worker
+  // threads, so that it can overlap creating the window and the simulator.
+  static std::unique_ptr<ImageLoader> decodeTextures(const std::string &project_root, Timeline *timeline = nullptr);
+
   void init();
 
   void loadFlock(Flock *flock);
   void loadFlockParameters(FlockParameters *fp);
   void loadCollisionObjects(vector<CollisionObject *> *objects);
+
+  // Saves the flock to checkpoint_path, or restores it from there, see
+  // flockCheckpoint.h. "K" and "L" do the same.
+  bool checkpointFlock();
+  bool restoreFlock();
+  std::string checkpoint_path = "flock.checkpoint";
   virtual bool isAlive();
   virtual void drawContents();
 
@@ -43,20 +61,28 @@ private:
   void drawPhong(GLShader &shader);
   
   void load_shaders();
-  void load_textures();
-  bool loadOBJ(const char* path,
-      std::vector < Vector3D >& out_vertices,
-      std::vector < Vector2D >& out_uvs,
-      std::vector < Vector3D >& out_normals
-  );
-
-  void drawBird(PointMass &pm, GLShader &shader, ShaderTypeHint stype);
+  GLShader &sceneShader(UserShader &user_shader);
+  GLShader &birdShader(UserShader &user_shader);
+  void load_textures(ImageLoader *textures, Timeline *timeline);
+  // `index` into TEXTURE_PATHS
+  void uploadTexture(int index, int width, int height, int channels, const unsigned char *pixels);
+
+  // Birds are drawn instanced: the mesh is uploaded once, each frame only
+  // streams the position and heading of every bird.
+  // position, normal and uv of each vertex, see IndexedMesh::interleaved
+  void uploadBirdMesh(const float *vertices, int num_vertices, const uint32_t *indices, int num_indices);
+  void pointBirdMesh(GLShader &shader);
+  void pointBirdInstances();
+  void drawBirds(GLShader &shader);
 
   
   // File management
   
   std::string m_project_root;
 
+  static const int NUM_TEXTURES = 10;
+  static const char *const TEXTURE_PATHS[NUM_TEXTURES];
+
   // Camera methods
 
   virtual void resetCamera();
@@ -86,6 +112,10 @@ private:
 
   vector<UserShader> shaders;
   vector<std::string> shaders_combobox_names;
+  // Of the programs, under the project root
+  std::unique_ptr<ShaderCache> shader_cache;
+  // Where shader links are marked, main()'s from start to the first frame
+  Timeline *timeline = nullptr;
   
   // OpenGL textures
   
@@ -148,21 +178,49 @@ private:
 
   bool is_alive = true;
 
-  std::vector< Vector3D > bd_vertices;
-  std::vector< Vector2D > bd_uvs;
-  std::vector< Vector3D > bd_normals;
+  const float bird_scale = 0.02;
+  int bird_index_count = 0;
+  GLuint bird_mesh_vbo = 0; // position, normal and uv of each vertex
+  GLuint bird_mesh_ebo = 0; // three vertices to a triangle
+  InstanceRing bird_instances{6};    // position and unit speed of each bird
+  int bird_instances_generation = 0; // of the buffer the shaders point at
+
+  // Timing overlay: time from one frame to the next and time spent writing
+  // the instances, averaged over TIMING_FRAMES frames.
+  static const int TIMING_FRAMES = 30;
+  Label *frame_label = nullptr;
+  Label *upload_label = nullptr;
+  std::chrono::steady_clock::time_point last_frame;
+  double frame_seconds = 0;
+  int frames = -1; // the first frame has no previous one
+  double upload_seconds = 0;
+  int upload_frames = 0;
+
+  // Flock parameter boxes, set again when a checkpoint is restored
+  FloatBox<double> *coherence_box = nullptr;
+  FloatBox<double> *alignment_box = nullptr;
+  FloatBox<double> *separation_box = nullptr;
+  IntBox<int> *num_birds_box = nullptr;
 
   Vector2i default_window_size = Vector2i(1024, 800);
 };
 
+// The programs are only made the first time they are drawn with, see
+// FlockSimulator::sceneShader and birdShader; until then they are null.
 struct UserShader {
-  UserShader(std::string display_name, std::shared_ptr<GLShader> nanogui_shader, ShaderTypeHint type_hint)
+  UserShader(std::string display_name, std::string vert_shader, std::string bird_vert_shader,
+             std::string frag_shader, ShaderTypeHint type_hint)
   : display_name(display_name)
-  , nanogui_shader(nanogui_shader)
+  , vert_shader(vert_shader)
+  , bird_vert_shader(bird_vert_shader)
+  , frag_shader(frag_shader)
   , type_hint(type_hint) {
   }
   
   std::shared_ptr<GLShader> nanogui_shader;
+  // The same fragment shader behind shaders/Bird.vert, for the birds.
+  std::shared_ptr<GLShader> bird_shader;
+  std::string vert_shader, bird_vert_shader, frag_shader;
   std::string display_name;
   ShaderTypeHint type_hint;
   
@@ -0,0 +1,161 @@
+#include <algorithm>
+
+#include "flockState.h"
+
+void FlockState::reserve(size_t n)
+{
+  px.reserve(n); py.reserve(n); pz.reserve(n);
+  vx.reserve(n); vy.reserve(n); vz.reserve(n);
+  ax.reserve(n); ay.reserve(n); az.reserve(n);
+  back.px.reserve(n); back.py.reserve(n); back.pz.reserve(n);
+  back.vx.reserve(n); back.vy.reserve(n); back.vz.reserve(n);
+  id.reserve(n);
+  index_of.reserve(n);
+  species_id.reserve(n);
+  cold.reserve(n);
+}
+
+void FlockState::clear()
+{
+  for (uint32_t bird : id)
+  {
+    generation[bird]++;
+  }
+  px.clear(); py.clear(); pz.clear();
+  vx.clear(); vy.clear(); vz.clear();
+  ax.clear(); ay.clear(); az.clear();
+  back.px.clear(); back.py.clear(); back.pz.clear();
+  back.vx.clear(); back.vy.clear(); back.vz.clear();
+  id.clear();
+  index_of.clear();
+  species_id.clear();
+  cold.clear();
+}
+
+size_t FlockState::add(const Vector3D &position, const Vector3D &speed, uint8_t species_index)
+{
+  px.push_back(position.x); py.push_back(position.y); pz.push_back(position.z);
+  vx.push_back(speed.x); vy.push_back(speed.y); vz.push_back(speed.z);
+  ax.push_back(0); ay.push_back(0); az.push_back(0);
+  back.px.push_back(position.x); back.py.push_back(position.y); back.pz.push_back(position.z);
+  back.vx.push_back(speed.x); back.vy.push_back(speed.y); back.vz.push_back(speed.z);
+  id.push_back(size() - 1);
+  index_of.push_back(size() - 1);
+  if (generation.size() < size())
+  {
+    generation.push_back(0);
+  }
+  species_id.push_back(species_index);
+
+  BirdColdState c;
+  c.start_position = position;
+  c.last_position = position;
+  cold.push_back(c);
+  return size() - 1;
+}
+
+void FlockState::moveBird(size_t from, size_t to)
+{
+  px[to] = px[from]; py[to] = py[from]; pz[to] = pz[from];
+  vx[to] = vx[from]; vy[to] = vy[from]; vz[to] = vz[from];
+  ax[to] = ax[from]; ay[to] = ay[from]; az[to] = az[from];
+  back.px[to] = back.px[from]; back.py[to] = back.py[from]; back.pz[to] = back.pz[from];
+  back.vx[to] = back.vx[from]; back.vy[to] = back.vy[from]; back.vz[to] = back.vz[from];
+  id[to] = id[from];
+  index_of[id[to]] = to;
+  species_id[to] = species_id[from];
+  cold[to] = cold[from];
+}
+
+void FlockState::truncate(size_t n)
+{
+  px.resize(n); py.resize(n); pz.resize(n);
+  vx.resize(n); vy.resize(n); vz.resize(n);
+  ax.resize(n); ay.resize(n); az.resize(n);
+  back.px.resize(n); back.py.resize(n); back.pz.resize(n);
+  back.vx.resize(n); back.vy.resize(n); back.vz.resize(n);
+  id.resize(n);
+  index_of.resize(n);
+  species_id.resize(n);
+  cold.resize(n);
+}
+
+void FlockState::pop_back(size_t count)
+{
+  // The birds with ids below `keep` stay. Those of them that sit in the tail
+  // move into the slots the removed birds leave before the tail, so ids stay
+  // dense and nothing but the removed birds and the movers is touched.
+  size_t n = size();
+  size_t keep = n - min(count, n);
+  size_t tail = keep;
+  for (size_t removed = keep; removed < n; removed++)
+  {
+    generation[removed]++;
+    size_t hole = index_of[removed];
+    if (hole >= keep)
+    {
+      continue;
+    }
+    while (id[tail] >= keep)
+    {
+      tail++;
+    }
+    moveBird(tail, hole);
+    tail++;
+  }
+  truncate(keep);
+}
+
+void FlockState::permute(const vector<int> &order)
+{
+  size_t n = size();
+  // The back buffer is overwritten by the next step anyway, so it serves as
+  // the scratch array of every float column.
+  Misc::AlignedVector<float> *columns[9] = {&px, &py, &pz, &vx, &vy, &vz, &ax, &ay, &az};
+  for (Misc::AlignedVector<float> *column : columns)
+  {
+    const float *from = column->data();
+    float *to = back.px.data();
+    for (size_t k = 0; k < n; k++)
+    {
+      to[k] = from[order[k]];
+    }
+    column->swap(back.px);
+  }
+
+  permuted_species_id.resize(n);
+  permuted_cold.resize(n);
+  for (size_t k = 0; k < n; k++)
+  {
+    permuted_species_id[k] = species_id[order[k]];
+    permuted_cold[k] = cold[order[k]];
+    index_of[id[order[k]]] = k; // id is still the old one here
+  }
+  for (size_t i = 0; i < n; i++)
+  {
+    id[index_of[i]] = i;
+  }
+  species_id.swap(permuted_species_id);
+  cold.swap(permuted_cold);
+}
+
+BirdSpan FlockState::frontSpan()
+{
+  BirdSpan span = {px.data(), py.data(), pz.data(), vx.data(), vy.data(), vz.data(),
+                   cold.data(), size()};
+  return span;
+}
+
+BirdSpan FlockState::backSpan()
+{
+  BirdSpan span = {back.px.data(), back.py.data(), back.pz.data(),
+                   back.vx.data(), back.vy.data(), back.vz.data(),
+                   cold.data(), size()};
+  return span;
+}
+
+void FlockState::swapBuffers()
+{
+  px.swap(back.px); py.swap(back.py); pz.swap(back.pz);
+  vx.swap(back.vx); vy.swap(back.vy); vz.swap(back.vz);
+}
@@ -0,0 +1,140 @@
+#ifndef FLOCK_STATE_H
+#define FLOCK_STATE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "CGL/CGL.h"
+#include "CGL/vector3D.h"
+#include "misc/aligned_allocator.h"
+
+using namespace CGL;
+using namespace std;
+
+// Speed and steering limits shared by every bird of a species. These used to
+// be copied into each PointMass.
+struct BirdSpecies {
+  double minSpeed = .0002;
+  double maxSpeed = .0004;
+  double maxAcc = 1.;
+  double minAcc = 0.;
+};
+
+// Per-bird fields the steering loop never touches.
+struct BirdColdState {
+  Vector3D start_position;
+  Vector3D last_position;
+
+  // position to stop on the bar if "S" is pressed
+  Vector3D rand_stop_pos;
+  bool has_stop_pos = false;
+  bool able_stop = false;
+  int branch = -1;
+
+  int timer = 100;
+};
+
+// Reference to a bird that stays valid while the bird lives, however the
+// flock is reordered. Ids of despawned birds are handed out again, but with
+// the next generation, so an old handle can tell its bird is gone.
+struct BirdHandle {
+  uint32_t id;
+  uint32_t generation;
+};
+
+// Non-owning view of one buffer of bird kinematics. Collision objects work
+// on a span so the step can point them at whichever buffer it is writing.
+struct BirdSpan {
+  float *px, *py, *pz;
+  float *vx, *vy, *vz;
+  BirdColdState *cold;
+  size_t size;
+
+  Vector3D position(size_t i) const { return Vector3D(px[i], py[i], pz[i]); }
+  Vector3D speed(size_t i) const { return Vector3D(vx[i], vy[i], vz[i]); }
+  void setPosition(size_t i, const Vector3D &p) { px[i] = p.x; py[i] = p.y; pz[i] = p.z; }
+  void setSpeed(size_t i, const Vector3D &v) { vx[i] = v.x; vy[i] = v.y; vz[i] = v.z; }
+};
+
+// Positions and speeds of the back buffer.
+struct FlockKinematics {
+  Misc::AlignedVector<float> px, py, pz;
+  Misc::AlignedVector<float> vx, vy, vz;
+};
+
+// Structure-of-arrays storage for the flock.
+//
+// Positions, speeds and accumulated steering live in separate 64-byte
+// aligned float arrays so the neighbour loop streams only the components it
+// needs. Everything else is kept in side tables indexed by bird.
+//
+// Positions and speeds are double buffered: a step reads the front arrays
+// (px..vz) of every bird, writes each bird's result into `back`, and then
+// swapBuffers() makes the result the new front.
+//
+// The index of a bird changes when the flock is reordered for locality, so
+// every bird also has a stable id: ids are 0 .. size() - 1 in the order the
+// birds were added, id[index] and index_of[id] map between the two.
+struct FlockState {
+  size_t size() const { return px.size(); }
+  void reserve(size_t n);
+  void clear();
+
+  // Appends a bird and returns its index. Its id is the old size().
+  size_t add(const Vector3D &position, const Vector3D &speed, uint8_t species_index = 0);
+  // Removes the bird added last (the one with the highest id).
+  void pop_back() { pop_back(1); }
+  // Removes the `count` birds added last, in time proportional to count.
+  void pop_back(size_t count);
+
+  BirdHandle handle(size_t index) const {
+    BirdHandle h = {id[index], generation[id[index]]};
+    return h;
+  }
+  // Index of the bird, or -1 if it has been despawned.
+  int indexOf(BirdHandle h) const {
+    return h.id < size() && generation[h.id] == h.generation ? (int)index_of[h.id] : -1;
+  }
+
+  // Moves bird order[k] to index k, for every k. Leaves the back buffer
+  // garbage, so it must run before a step, not inside one.
+  void permute(const vector<int> &order);
+
+  Vector3D position(size_t i) const { return Vector3D(px[i], py[i], pz[i]); }
+  Vector3D speed(size_t i) const { return Vector3D(vx[i], vy[i], vz[i]); }
+  Vector3D steering(size_t i) const { return Vector3D(ax[i], ay[i], az[i]); }
+
+  void setPosition(size_t i, const Vector3D &p) { px[i] = p.x; py[i] = p.y; pz[i] = p.z; }
+  void setSpeed(size_t i, const Vector3D &v) { vx[i] = v.x; vy[i] = v.y; vz[i] = v.z; }
+  void setSteering(size_t i, const Vector3D &a) { ax[i] = a.x; ay[i] = a.y; az[i] = a.z; }
+
+  const BirdSpecies &speciesOf(size_t i) const { return species[species_id[i]]; }
+
+  BirdSpan frontSpan();
+  BirdSpan backSpan();
+  void swapBuffers();
+
+  // hot state
+  Misc::AlignedVector<float> px, py, pz;
+  Misc::AlignedVector<float> vx, vy, vz;
+  Misc::AlignedVector<float> ax, ay, az;
+  FlockKinematics back;
+
+  // side tables
+  vector<uint32_t> id;
+  vector<uint32_t> index_of;
+  vector<uint32_t> generation; // by id; kept for ids no bird has right now
+  vector<uint8_t> species_id;
+  vector<BirdSpecies> species = vector<BirdSpecies>(1);
+  vector<BirdColdState> cold;
+
+private:
+  void moveBird(size_t from, size_t to);
+  void truncate(size_t n);
+
+  // scratch of permute()
+  vector<uint8_t> permuted_species_id;
+  vector<BirdColdState> permuted_cold;
+};
+
+#endif /* FLOCK_STATE_H */
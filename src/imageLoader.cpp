@@ -0,0 +1,106 @@
+#include "imageLoader.h"
+
+#include <algorithm>
+#include <iostream>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "misc/stb_image.h"
+#include "misc/timeline.h"
+
+// Workers read stbi_failure_reason() after their own stbi_load, which is
+// only their own reason when stb_image keeps it per thread
+#ifndef STBI_THREAD_LOCAL
+#error "stb_image's failure reason must be thread local for ImageLoader"
+#endif
+
+using namespace std;
+
+RGBImage::~RGBImage()
+{
+  stbi_image_free(pixels);
+}
+
+bool RGBImage::load(const string &filename)
+{
+  stbi_image_free(pixels);
+  // stb_image keeps nothing between calls but its failure reason, which is
+  // thread local (STBI_THREAD_LOCAL), so workers can decode at once
+  pixels = stbi_load(filename.c_str(), &width, &height, &channels, 3);
+  if (!pixels)
+  {
+    width = height = channels = 0;
+    return false;
+  }
+  return true;
+}
+
+ImageLoader::ImageLoader(const vector<string> &filenames, int num_threads, Timeline *timeline)
+    : filenames(filenames), timeline(timeline)
+{
+  if (num_threads <= 0)
+  {
+    num_threads = max(1u, thread::hardware_concurrency());
+  }
+  num_threads = min((size_t)num_threads, filenames.size());
+  for (int i = 0; i < num_threads; i++)
+  {
+    workers.push_back(thread(&ImageLoader::work, this));
+  }
+}
+
+ImageLoader::~ImageLoader()
+{
+  {
+    lock_guard<mutex> lock(queue_mutex);
+    stopping = true;
+  }
+  for (thread &worker : workers)
+  {
+    worker.join();
+  }
+}
+
+void ImageLoader::work()
+{
+  while (true)
+  {
+    size_t index;
+    {
+      lock_guard<mutex> lock(queue_mutex);
+      if (stopping || next_file == filenames.size())
+      {
+        return;
+      }
+      index = next_file++;
+    }
+
+    unique_ptr<RGBImage> image(new RGBImage);
+    if (!image->load(filenames[index]))
+    {
+      cout << "Error: cannot decode " << filenames[index] << ": " << stbi_failure_reason() << endl;
+    }
+    if (timeline)
+    {
+      timeline->mark("decoded " + filenames[index]);
+    }
+
+    lock_guard<mutex> lock(queue_mutex);
+    done.push_back(make_pair(index, move(image)));
+    finished.notify_one();
+  }
+}
+
+bool ImageLoader::next(unique_ptr<RGBImage> &image, size_t &index)
+{
+  unique_lock<mutex> lock(queue_mutex);
+  if (taken == filenames.size())
+  {
+    return false;
+  }
+  finished.wait(lock, [this] { return !done.empty(); });
+  index = done.front().first;
+  image = move(done.front().second);
+  done.pop_front();
+  taken++;
+  return true;
+}
@@ -0,0 +1,69 @@
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class Timeline;
+
+// An image file decoded by stb_image to 8 bit RGB, first row first.
+struct RGBImage
+{
+  int width = 0, height = 0;
+  int channels = 0; // of the file
+  unsigned char *pixels = nullptr;
+
+  RGBImage() {}
+  ~RGBImage();
+  RGBImage(const RGBImage &) = delete;
+  RGBImage &operator=(const RGBImage &) = delete;
+
+  // False, with no pixels, when the file cannot be read or decoded.
+  bool load(const std::string &filename);
+};
+
+// Decodes a list of image files on worker threads, starting as soon as it
+// is made, so that the GL thread can get on with other work and upload
+// each image as it comes out.
+class ImageLoader
+{
+public:
+  // num_threads 0 is one a core; never more than there are files.
+  ImageLoader(const std::vector<std::string> &filenames, int num_threads = 0, Timeline *timeline = nullptr);
+  // Skips what has not been started and waits for the rest.
+  ~ImageLoader();
+  ImageLoader(const ImageLoader &) = delete;
+  ImageLoader &operator=(const ImageLoader &) = delete;
+
+  // Waits for the next image to finish, in whatever order they do, and
+  // hands it over with its place in the list. False once every image was
+  // taken. A file that failed comes out with no pixels.
+  bool next(std::unique_ptr<RGBImage> &image, size_t &index);
+
+  size_t size() const { return filenames.size(); }
+  int numThreads() const { return workers.size(); }
+
+private:
+  void work();
+
+  std::vector<std::string> filenames;
+  Timeline *timeline;
+
+  std::mutex queue_mutex;
+  std::condition_variable finished;
+  size_t next_file = 0; // to start
+  size_t taken = 0;     // by next()
+  bool stopping = false;
+  std::deque<std::pair<size_t, std::unique_ptr<RGBImage> > > done;
+
+  std::vector<std::thread> workers; // last, so they start after the rest is set up
+};
+
+#endif /* IMAGE_LOADER_H */
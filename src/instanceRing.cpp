@@ -0,0 +1,79 @@
+#include <algorithm>
+
+#include "instanceRing.h"
+
+using namespace std;
+
+static void waitFor(GLsync &fence) {
+  if (!fence) {
+    return;
+  }
+  while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+  }
+  glDeleteSync(fence);
+  fence = 0;
+}
+
+InstanceRing::~InstanceRing() {
+  for (GLsync &fence : fences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  glDeleteBuffers(1, &id); // unmaps it too
+}
+
+void InstanceRing::reallocate(size_t count) {
+  for (GLsync &fence : fences) {
+    waitFor(fence);
+  }
+  glDeleteBuffers(1, &id);
+  glGenBuffers(1, &id);
+  glBindBuffer(GL_ARRAY_BUFFER, id);
+  // some headroom, so a growing flock does not reallocate every frame
+  capacity = max(count, capacity + capacity / 2);
+  GLsizeiptr size = NUM_SECTIONS * capacity * element_floats * sizeof(float);
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+  memory = (float *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+  section = 0;
+  generation++;
+}
+
+float *InstanceRing::map(size_t count) {
+  if (!id) {
+    persistent = GLAD_GL_VERSION_4_4;
+    if (!persistent) {
+      glGenBuffers(1, &id);
+      generation++;
+    }
+  }
+  if (!persistent) {
+    // orphan: the draws of the last frame keep the old storage
+    GLsizeiptr size = max(count, (size_t)1) * element_floats * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, id);
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    return (float *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  }
+
+  if (!id || count > capacity) {
+    reallocate(count);
+  } else {
+    section = (section + 1) % NUM_SECTIONS;
+    waitFor(fences[section]);
+  }
+  return memory + section * capacity * element_floats;
+}
+
+void InstanceRing::unmap() {
+  if (!persistent) {
+    glBindBuffer(GL_ARRAY_BUFFER, id);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+}
+
+void InstanceRing::fence() {
+  if (persistent) {
+    fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+}
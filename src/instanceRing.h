@@ -0,0 +1,48 @@
+#ifndef INSTANCE_RING_H
+#define INSTANCE_RING_H
+
+#include <cstddef>
+#include <glad/glad.h>
+
+// Per-frame vertex data that the CPU writes straight into buffer memory.
+//
+// With GL 4.4 the buffer is mapped once, persistently and coherently, and
+// cut into NUM_SECTIONS sections used in turn. A fence after the draws of
+// each frame keeps map() from handing out a section the GPU may still be
+// reading. Without GL 4.4 every frame orphans the buffer and maps the fresh
+// storage, so the driver does not have to wait for the last frame either.
+class InstanceRing {
+public:
+  InstanceRing(int element_floats) : element_floats(element_floats) {}
+  ~InstanceRing();
+
+  // Room for count elements of element_floats floats, for this frame.
+  float *map(size_t count);
+  // Before the draws that read what map() returned...
+  void unmap();
+  // ...and after them.
+  void fence();
+
+  GLuint buffer() const { return id; }
+  // First element of what map() returned, the base instance of the draws.
+  GLuint baseInstance() const { return (GLuint)(section * capacity); }
+  bool isPersistent() const { return persistent; }
+
+  static const int NUM_SECTIONS = 3;
+  const int element_floats;
+  // Bumped whenever map() made a new buffer, whose attribute pointers then
+  // have to be set again.
+  int generation = 0;
+
+private:
+  void reallocate(size_t count);
+
+  GLuint id = 0;
+  bool persistent = false;
+  float *memory = nullptr; // persistent mapping
+  size_t capacity = 0;     // elements per section
+  int section = 0;
+  GLsync fences[NUM_SECTIONS] = {};
+};
+
+#endif /* INSTANCE_RING_H */
@@ -0,0 +1,65 @@
+#ifndef CGL_UTIL_ALIGNED_ALLOCATOR_H
+#define CGL_UTIL_ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace CGL {
+namespace Misc {
+
+/**
+ * Minimal allocator returning storage aligned to `Alignment` bytes, so that
+ * std::vector buffers start on a cache line and can be loaded with aligned
+ * SIMD instructions.
+ */
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind {
+    typedef AlignedAllocator<U, Alignment> other;
+  };
+
+  AlignedAllocator() {}
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+  T *allocate(size_t n) {
+    if (n == 0) return nullptr;
+    void *ptr = nullptr;
+#ifdef _WIN32
+    ptr = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+    if (posix_memalign(&ptr, Alignment, n * sizeof(T)) != 0) ptr = nullptr;
+#endif
+    if (!ptr) throw std::bad_alloc();
+    return static_cast<T *>(ptr);
+  }
+
+  void deallocate(T *ptr, size_t) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+  }
+};
+
+template <typename T, typename U, size_t A>
+bool operator==(const AlignedAllocator<T, A> &, const AlignedAllocator<U, A> &) { return true; }
+template <typename T, typename U, size_t A>
+bool operator!=(const AlignedAllocator<T, A> &, const AlignedAllocator<U, A> &) { return false; }
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T> >;
+
+} // namespace Misc
+} // namespace CGL
+
+#endif // CGL_UTIL_ALIGNED_ALLOCATOR_H
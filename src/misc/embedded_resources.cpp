@@ -0,0 +1,53 @@
+#include "embedded_resources.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace EmbeddedResources {
+
+#ifndef FLOCK_EMBEDDED_RESOURCES
+// nothing baked in
+const Tables tables = {nullptr, 0, nullptr, 0, nullptr, 0};
+#endif
+
+bool baked() {
+  return tables.num_texts + tables.num_images + tables.num_meshes > 0;
+}
+
+// A handful of entries, so a scan is as good as anything.
+template <typename T>
+static const T *find(const T *entries, size_t count, const std::string &path) {
+  for (size_t i = 0; i < count; i++) {
+    if (path == entries[i].path) {
+      return &entries[i];
+    }
+  }
+  return nullptr;
+}
+
+const Text *findText(const std::string &path) {
+  return find(tables.texts, tables.num_texts, path);
+}
+
+const Image *findImage(const std::string &path) {
+  return find(tables.images, tables.num_images, path);
+}
+
+const Mesh *findMesh(const std::string &path) {
+  return find(tables.meshes, tables.num_meshes, path);
+}
+
+std::vector<std::string> listTexts(const std::string &dir) {
+  std::string prefix = dir + "/";
+  std::vector<std::string> names;
+  for (size_t i = 0; i < tables.num_texts; i++) {
+    const char *path = tables.texts[i].path;
+    if (strncmp(path, prefix.c_str(), prefix.size()) == 0 && !strchr(path + prefix.size(), '/')) {
+      names.push_back(path + prefix.size());
+    }
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+} // namespace EmbeddedResources
@@ -0,0 +1,65 @@
+#ifndef CGL_UTIL_EMBEDDEDRESOURCES_H
+#define CGL_UTIL_EMBEDDEDRESOURCES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Files of the project root that flock_bake compiled into the viewer at
+ * build time (EMBED_RESOURCES, on by default), so that starting it reads and
+ * decodes nothing: the bird mesh as vertex and index arrays, the shader
+ * sources, and the textures already decoded to RGB.
+ *
+ * Resources are looked up by their path under the project root, with
+ * forward slashes. In a build without them every lookup finds nothing and
+ * the viewer reads the files instead.
+ */
+namespace EmbeddedResources {
+
+struct Text {
+  const char *path;
+  const char *text;
+  size_t size;
+};
+
+struct Image {
+  const char *path;
+  int width, height;
+  int channels;                // of the file; the pixels are always RGB
+  const unsigned char *pixels; // width * height * 3, first row first
+};
+
+struct Mesh {
+  const char *path;
+  const float *vertices; // position, normal and uv of each vertex, see IndexedMesh::interleaved
+  size_t num_vertices;
+  const uint32_t *indices;
+  size_t num_indices;
+};
+
+// Whether this build has any.
+bool baked();
+
+const Text *findText(const std::string &path);
+const Image *findImage(const std::string &path);
+const Mesh *findMesh(const std::string &path);
+
+// Names of the texts directly in `dir` (e.g. "shaders"), sorted.
+std::vector<std::string> listTexts(const std::string &dir);
+
+// What flock_bake generates.
+struct Tables {
+  const Text *texts;
+  size_t num_texts;
+  const Image *images;
+  size_t num_images;
+  const Mesh *meshes;
+  size_t num_meshes;
+};
+extern const Tables tables;
+
+} // namespace EmbeddedResources
+
+#endif // CGL_UTIL_EMBEDDEDRESOURCES_H
@@ -1,9 +1,15 @@
 #ifdef _WIN32
 #include "dirent.h"
+#include <direct.h>
 #else
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif // WIN32
 
+#include <cerrno>
 #include <fstream>
 
 #include "file_utils.h"
@@ -60,4 +66,60 @@ bool file_exists(const std::string& test_filename) {
   return true;
 }
 
+bool make_directory(const std::string& dir_path) {
+#ifdef _WIN32
+  return _mkdir(dir_path.c_str()) == 0 || errno == EEXIST;
+#else
+  return mkdir(dir_path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+bool MappedFile::open(const std::string& filename) {
+  close();
+#ifndef _WIN32
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    ::close(fd);
+    return false;
+  }
+  length = info.st_size;
+  if (length == 0) {
+    ::close(fd);
+    return true;
+  }
+  void* address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping keeps the file
+  if (address != MAP_FAILED) {
+    bytes = (const char*)address;
+    mapped = true;
+    return true;
+  }
+#endif
+  std::ifstream file(filename, std::ios::binary);
+  if (file.fail()) {
+    length = 0;
+    return false;
+  }
+  buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  bytes = buffer.data();
+  length = buffer.size();
+  return true;
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+  if (mapped) {
+    munmap((void*)bytes, length);
+  }
+#endif
+  std::vector<char>().swap(buffer);
+  bytes = nullptr;
+  length = 0;
+  mapped = false;
+}
+
 }
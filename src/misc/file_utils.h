@@ -1,14 +1,40 @@
 #ifndef CS184_FILE_UTILS_H
 #define CS184_FILE_UTILS_H
 
+#include <cstddef>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace FileUtils {
 
 bool list_files_in_directory(const std::string& dir_path, std::set<std::string>& retval);
 bool split_filename(const std::string& filename, std::string& before_extension, std::string& extension);
 bool file_exists(const std::string& filename);
+// True when the directory exists afterwards, made now or before.
+bool make_directory(const std::string& dir_path);
+
+// A whole file, read only: memory mapped where the platform allows, read
+// into memory otherwise.
+class MappedFile {
+public:
+  MappedFile() {}
+  ~MappedFile() { close(); }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool open(const std::string& filename);
+  void close();
+
+  const char* data() const { return bytes; }
+  size_t size() const { return length; }
+
+private:
+  const char* bytes = nullptr;
+  size_t length = 0;
+  bool mapped = false;
+  std::vector<char> buffer; // when not mapped
+};
 
 }
 
@@ -88,10 +88,10 @@ int SphereMesh::s_index(int x, int y) {
 
 void SphereMesh::build_data() {
   
-  positions = MatrixXf(4, sphere_num_indices * 3);
-  normals = MatrixXf(4, sphere_num_indices * 3);
-  uvs = MatrixXf(2, sphere_num_indices * 3);
-  tangents = MatrixXf(4, sphere_num_indices * 3);
+  std::vector<float> positions;
+  std::vector<float> normals;
+  std::vector<float> uvs;
+  std::vector<float> tangents;
 
   for (int i = 0; i < sphere_num_indices; i += 3) {
     double *vPtr1 = &Vertices[VERTEX_SIZE * Indices[i]];
@@ -123,22 +123,27 @@ void SphereMesh::build_data() {
     Vector3D t3(vPtr3[TANGEN_OFFSET], vPtr3[TANGEN_OFFSET + 1],
                 vPtr3[TANGEN_OFFSET + 2]);
 
-    positions.col(i    ) << p1.x, p1.y, p1.z, 1.0;
-    positions.col(i + 1) << p2.x, p2.y, p2.z, 1.0;
-    positions.col(i + 2) << p3.x, p3.y, p3.z, 1.0;
+    positions.insert(positions.end(), {(float)p1.x, (float)p1.y, (float)p1.z, 1.0,
+                                       (float)p2.x, (float)p2.y, (float)p2.z, 1.0,
+                                       (float)p3.x, (float)p3.y, (float)p3.z, 1.0});
 
-    normals.col(i    ) << n1.x, n1.y, n1.z, 0.0;
-    normals.col(i + 1) << n2.x, n2.y, n2.z, 0.0;
-    normals.col(i + 2) << n3.x, n3.y, n3.z, 0.0;
+    normals.insert(normals.end(), {(float)n1.x, (float)n1.y, (float)n1.z, 0.0,
+                                   (float)n2.x, (float)n2.y, (float)n2.z, 0.0,
+                                   (float)n3.x, (float)n3.y, (float)n3.z, 0.0});
     
-    uvs.col(i    ) << uv1.x, uv1.y;
-    uvs.col(i + 1) << uv2.x, uv2.y;
-    uvs.col(i + 2) << uv3.x, uv3.y;
+    uvs.insert(uvs.end(), {(float)uv1.x, (float)uv1.y,
+                           (float)uv2.x, (float)uv2.y,
+                           (float)uv3.x, (float)uv3.y});
     
-    tangents.col(i    ) << t1.x, t1.y, t1.z, 0.0;
-    tangents.col(i + 1) << t2.x, t2.y, t2.z, 0.0;
-    tangents.col(i + 2) << t3.x, t3.y, t3.z, 0.0;
+    tangents.insert(tangents.end(), {(float)t1.x, (float)t1.y, (float)t1.z, 0.0,
+                                     (float)t2.x, (float)t2.y, (float)t2.z, 0.0,
+                                     (float)t3.x, (float)t3.y, (float)t3.z, 0.0});
   }
+
+  mesh.addAttrib("in_position", 4, positions);
+  mesh.addAttrib("in_normal", 4, normals);
+  mesh.addAttrib("in_uv", 2, uvs);
+  mesh.addAttrib("in_tangent", 4, tangents);
 }
 
 void SphereMesh::draw_sphere(GLShader &shader, const Vector3D &p, double r) {
@@ -148,19 +153,7 @@ void SphereMesh::draw_sphere(GLShader &shader, const Vector3D &p, double r) {
 
   shader.setUniform("u_model", model);
 
-
-  shader.uploadAttrib("in_position", positions);
-  if (shader.attrib("in_normal", false) != -1) {
-    shader.uploadAttrib("in_normal", normals);
-  }
-  if (shader.attrib("in_uv", false) != -1) {
-    shader.uploadAttrib("in_uv", uvs);
-  }
-  if (shader.attrib("in_tangent", false) != -1) {
-    shader.uploadAttrib("in_tangent", tangents, false);
-  }
-
-  shader.drawArray(GL_TRIANGLES, 0, sphere_num_indices);
+  mesh.draw(shader, GL_TRIANGLES);
 }
 
 } // namespace Misc
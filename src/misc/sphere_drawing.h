@@ -6,6 +6,7 @@
 #include <nanogui/nanogui.h>
 
 #include "CGL/CGL.h"
+#include "static_mesh.h"
 
 using namespace nanogui;
 
@@ -37,10 +38,8 @@ private:
   int sphere_num_vertices;
   int sphere_num_indices;
   
-  MatrixXf positions;
-  MatrixXf normals;
-  MatrixXf uvs;
-  MatrixXf tangents;
+  // the unit sphere, uploaded once
+  StaticMesh mesh;
 };
 
 
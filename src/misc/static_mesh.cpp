@@ -0,0 +1,66 @@
+#include "static_mesh.h"
+
+namespace CGL {
+namespace Misc {
+
+StaticMesh::~StaticMesh() {
+  // nothing was uploaded, which also means there may be no GL context yet
+  if (!vbo) {
+    return;
+  }
+  for (auto &vertex_array : vertex_arrays) {
+    glDeleteVertexArrays(1, &vertex_array.second);
+  }
+  glDeleteBuffers(1, &vbo);
+}
+
+void StaticMesh::addAttrib(const std::string &name, int dim, const std::vector<float> &values) {
+  Attrib attrib;
+  attrib.name = name;
+  attrib.dim = dim;
+  attrib.offset = data.size() * sizeof(float);
+  attribs.push_back(attrib);
+  data.insert(data.end(), values.begin(), values.end());
+  num_vertices = values.size() / dim;
+}
+
+void StaticMesh::upload() {
+  glGenBuffers(1, &vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.data(), GL_STATIC_DRAW);
+  std::vector<float>().swap(data);
+}
+
+GLuint StaticMesh::vertexArray(GLShader &shader) {
+  for (auto &vertex_array : vertex_arrays) {
+    if (vertex_array.first == &shader) {
+      return vertex_array.second;
+    }
+  }
+  GLuint id;
+  glGenVertexArrays(1, &id);
+  glBindVertexArray(id);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  for (const Attrib &attrib : attribs) {
+    GLint location = shader.attrib(attrib.name, false);
+    if (location >= 0) {
+      glEnableVertexAttribArray(location);
+      glVertexAttribPointer(location, attrib.dim, GL_FLOAT, GL_FALSE, 0, (const void *)attrib.offset);
+    }
+  }
+  vertex_arrays.push_back(std::make_pair(&shader, id));
+  return id;
+}
+
+void StaticMesh::draw(GLShader &shader, GLenum mode) {
+  if (!vbo) {
+    upload();
+  }
+  glBindVertexArray(vertexArray(shader));
+  glDrawArrays(mode, 0, num_vertices);
+  // back to the shader's own vertex array, which its uploadAttrib expects
+  shader.bind();
+}
+
+} // namespace Misc
+} // namespace CGL
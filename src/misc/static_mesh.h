@@ -0,0 +1,56 @@
+#ifndef CGL_UTIL_STATICMESH_H
+#define CGL_UTIL_STATICMESH_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nanogui/nanogui.h>
+
+using namespace nanogui;
+
+namespace CGL {
+namespace Misc {
+
+/**
+ * Geometry that never changes, uploaded to the GPU on the first draw and
+ * drawn with one call from then on.
+ *
+ * Attribute locations differ between shader programs, so every shader the
+ * mesh is drawn with gets a vertex array of its own, all reading the same
+ * buffer.
+ */
+class StaticMesh {
+public:
+  StaticMesh() {}
+  ~StaticMesh();
+
+  // Adds a vertex attribute of dim floats per vertex, for shaders that read
+  // it as `name`. Only before the first draw.
+  void addAttrib(const std::string &name, int dim, const std::vector<float> &data);
+  int numVertices() const { return num_vertices; }
+
+  // Draws the whole mesh with the bound shader.
+  void draw(GLShader &shader, GLenum mode);
+
+private:
+  struct Attrib {
+    std::string name;
+    int dim;
+    size_t offset; // in the buffer, bytes
+  };
+
+  void upload();
+  GLuint vertexArray(GLShader &shader);
+
+  std::vector<Attrib> attribs;
+  std::vector<float> data; // until uploaded
+  int num_vertices = 0;
+  GLuint vbo = 0;
+  std::vector<std::pair<const GLShader *, GLuint> > vertex_arrays;
+};
+
+} // namespace Misc
+} // namespace CGL
+
+#endif // CGL_UTIL_STATICMESH_H
@@ -0,0 +1,44 @@
+#ifndef CGL_UTIL_TIMELINE_H
+#define CGL_UTIL_TIMELINE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Named moments since the timeline was made, marked from any thread and
+ * printed in order, e.g. what the viewer does between main() and its first
+ * frame.
+ */
+class Timeline {
+public:
+  Timeline() : start(std::chrono::steady_clock::now()) {}
+
+  void mark(const std::string &what) {
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(mutex);
+    marks.push_back(std::make_pair(ms, what));
+  }
+
+  void print() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::stable_sort(marks.begin(), marks.end(),
+                     [](const std::pair<double, std::string> &a, const std::pair<double, std::string> &b) {
+                       return a.first < b.first;
+                     });
+    for (const auto &mark : marks) {
+      printf("%9.1f ms  %s\n", mark.first, mark.second.c_str());
+    }
+  }
+
+private:
+  std::chrono::steady_clock::time_point start;
+  std::mutex mutex;
+  std::vector<std::pair<double, std::string> > marks;
+};
+
+#endif // CGL_UTIL_TIMELINE_H
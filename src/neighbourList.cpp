@@ -0,0 +1,96 @@
+#include <algorithm>
+
+#include "neighbourList.h"
+
+using namespace std;
+
+bool NeighbourList::build(const FlockState &state, const SpatialGrid &grid, double radius, double skin)
+{
+  int n = state.size();
+  this->radius = radius;
+  this->skin = skin;
+  ref_px.assign(state.px.begin(), state.px.end());
+  ref_py.assign(state.py.begin(), state.py.end());
+  ref_pz.assign(state.pz.begin(), state.pz.end());
+  offsets.resize(n + 1);
+  offsets[0] = 0;
+
+  // Same float distance test as the steering kernel.
+  const float cutoff2 = (float)((radius + skin) * (radius + skin));
+  const float *px = state.px.data(), *py = state.py.data(), *pz = state.pz.data();
+
+  // Two passes, counting and then filling, so the lists can be written in
+  // parallel straight into one array.
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < n; i++)
+  {
+    int count = 0;
+    grid.query(state.position(i), [&](int j) {
+      float dx = px[j] - px[i], dy = py[j] - py[i], dz = pz[j] - pz[i];
+      if (j != i && dx * dx + dy * dy + dz * dz < cutoff2)
+      {
+        count++;
+      }
+    });
+    offsets[i + 1] = count;
+  }
+
+  size_t total = 0;
+  for (int i = 0; i < n; i++)
+  {
+    total += offsets[i + 1];
+  }
+  if (total > MAX_ENTRIES)
+  {
+    is_valid = false;
+    indices.clear();
+    return false;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    offsets[i + 1] += offsets[i];
+  }
+
+  // The lists breathe with the flock's density; the headroom keeps that from
+  // reallocating them on most rebuilds.
+  if (total > indices.capacity())
+  {
+    indices.reserve(min(total + total / 4, (size_t)MAX_ENTRIES));
+  }
+  indices.resize(total);
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < n; i++)
+  {
+    int *out = indices.data() + offsets[i];
+    grid.query(state.position(i), [&](int j) {
+      float dx = px[j] - px[i], dy = py[j] - py[i], dz = pz[j] - pz[i];
+      if (j != i && dx * dx + dy * dy + dz * dz < cutoff2)
+      {
+        *out++ = j;
+      }
+    });
+  }
+  is_valid = true;
+  return true;
+}
+
+bool NeighbourList::needsRebuild(const FlockState &state, double radius, double skin) const
+{
+  int n = state.size();
+  if (radius != this->radius || skin != this->skin || n != (int)ref_px.size())
+  {
+    return true;
+  }
+
+  // Written as !(d2 <= limit) so a NaN position also forces a rebuild.
+  const float limit2 = (float)(skin * skin / 4);
+  const float *px = state.px.data(), *py = state.py.data(), *pz = state.pz.data();
+  int moved_far = 0;
+  #pragma omp parallel for reduction(| : moved_far)
+  for (int i = 0; i < n; i++)
+  {
+    float dx = px[i] - ref_px[i], dy = py[i] - ref_py[i], dz = pz[i] - ref_pz[i];
+    moved_far |= !(dx * dx + dy * dy + dz * dz <= limit2);
+  }
+  return moved_far != 0;
+}
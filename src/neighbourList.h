@@ -0,0 +1,77 @@
+#ifndef NEIGHBOUR_LIST_H
+#define NEIGHBOUR_LIST_H
+
+#include <vector>
+
+#include "CGL/CGL.h"
+#include "flockState.h"
+#include "misc/aligned_allocator.h"
+#include "spatialGrid.h"
+
+using namespace CGL;
+using namespace std;
+
+// Where Flock::simulate spends its time outside the steering loop, to see
+// how often the lists are rebuilt and what reusing them saves.
+struct NeighbourStats {
+  long steps = 0;              // steps that needed neighbours
+  long rebuilds = 0;           // steps that rebuilt the grid (and lists)
+  long overflows = 0;          // list builds that hit MAX_ENTRIES
+  long reorders = 0;           // Morton reorders of the flock
+  long spawned = 0;            // birds added and removed by spawn_birds
+  long despawned = 0;          // and despawn_birds
+  long grid_builds = 0;
+  long grid_updates = 0;       // grid builds that only moved birds
+  long migrations = 0;         // birds those moved to another cell
+  double rebuild_seconds = 0;  // grid + list builds
+  double grid_seconds = 0;     // grid builds alone, part of the above
+  double check_seconds = 0;    // displacement checks of the other steps
+  double steering_seconds = 0; // neighbour accumulation and integration
+  double collision_seconds = 0; // part of the above, summed over threads
+  long collided = 0;            // birds passed through the collision objects
+  double reorder_seconds = 0;
+  double population_seconds = 0; // spawning and despawning
+};
+
+// Verlet neighbour lists: every bird within radius + skin of each bird,
+// kept across steps.
+//
+// As long as no bird has moved more than skin / 2 since the lists were
+// built, every pair that is now closer than radius was closer than
+// radius + skin then, so the lists still hold all neighbours and only need
+// the exact distance test. Birds move at most maxSpeed = 0.0004 per step,
+// which lets one build serve dozens of substeps.
+struct NeighbourList {
+  // Builds the lists with a grid whose cells are at least radius + skin.
+  // Returns false (and leaves the lists invalid) when they would hold more
+  // than MAX_ENTRIES indices, which happens when most of a large flock is
+  // within range of each other; the caller then queries the grid directly.
+  bool build(const FlockState &state, const SpatialGrid &grid, double radius, double skin);
+
+  // True if the lists can no longer be trusted for the given radius.
+  bool needsRebuild(const FlockState &state, double radius, double skin) const;
+
+  bool valid() const { return is_valid; }
+  // Forces the next needsRebuild() to say yes, e.g. after the birds moved
+  // to new indices.
+  void invalidate() { is_valid = false; radius = -1; }
+  size_t numEntries() const { return indices.size(); }
+
+  // Neighbour candidates of bird i are indices[offsets[i] .. offsets[i + 1]).
+  const int *neighbours(int i) const { return indices.data() + offsets[i]; }
+  int numNeighbours(int i) const { return offsets[i + 1] - offsets[i]; }
+
+  static const size_t MAX_ENTRIES = 1 << 26;
+
+  double radius = -1;
+  double skin = 0;
+  bool is_valid = false;
+
+  vector<int> offsets;
+  vector<int> indices;
+  // positions at the last build (or failed build)
+  Misc::AlignedVector<float> ref_px, ref_py, ref_pz;
+
+};
+
+#endif /* NEIGHBOUR_LIST_H */
@@ -0,0 +1,531 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "flockRandom.h"
+#include "misc/file_utils.h"
+#include "objLoader.h"
+
+using namespace std;
+
+void IndexedMesh::clear()
+{
+  positions.clear();
+  uvs.clear();
+  normals.clear();
+  indices.clear();
+}
+
+vector<float> IndexedMesh::interleaved() const
+{
+  vector<float> vertices;
+  vertices.reserve(numVertices() * 8);
+  for (size_t i = 0; i < numVertices(); i++)
+  {
+    vertices.insert(vertices.end(), &positions[i * 3], &positions[i * 3] + 3);
+    vertices.insert(vertices.end(), &normals[i * 3], &normals[i * 3] + 3);
+    vertices.insert(vertices.end(), &uvs[i * 2], &uvs[i * 2] + 2);
+  }
+  return vertices;
+}
+
+namespace
+{
+
+inline bool isBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+inline void skipBlanks(const char *&p, const char *end)
+{
+  while (p < end && isBlank(*p))
+  {
+    p++;
+  }
+}
+
+inline void skipLine(const char *&p, const char *end)
+{
+  const char *newline = (const char *)memchr(p, '\n', end - p);
+  p = newline ? newline + 1 : end;
+}
+
+// Powers of ten a double holds exactly.
+const double EXACT_POWERS_OF_TEN[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Reads the number at p. Numbers of up to 15 significant digits, which is
+// all an exporter writes, are one multiply or divide of two exact doubles
+// and so rounded correctly, the same as strtod; anything longer goes to
+// strtod.
+bool parseDouble(const char *&p, const char *end, double &value)
+{
+  skipBlanks(p, end);
+  const char *start = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+  {
+    negative = *p == '-';
+    p++;
+  }
+  uint64_t mantissa = 0;
+  int digits = 0, exponent = 0;
+  bool any_digit = false, exact = true, fraction = false;
+  for (; p < end; p++)
+  {
+    if (*p == '.' && !fraction)
+    {
+      fraction = true;
+      continue;
+    }
+    if (!isDigit(*p))
+    {
+      break;
+    }
+    any_digit = true;
+    int digit = *p - '0';
+    if (mantissa == 0 && digit == 0)
+    {
+      exponent -= fraction;
+      continue;
+    }
+    if (digits < 15)
+    {
+      mantissa = mantissa * 10 + digit;
+      digits++;
+      exponent -= fraction;
+    }
+    else
+    {
+      exact = false;
+    }
+  }
+  if (!any_digit)
+  {
+    p = start;
+    return false;
+  }
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    const char *q = p + 1;
+    bool negative_exponent = false;
+    if (q < end && (*q == '-' || *q == '+'))
+    {
+      negative_exponent = *q == '-';
+      q++;
+    }
+    if (q < end && isDigit(*q))
+    {
+      int e = 0;
+      for (; q < end && isDigit(*q); q++)
+      {
+        e = e < 10000 ? e * 10 + (*q - '0') : e;
+      }
+      exponent += negative_exponent ? -e : e;
+      p = q;
+    }
+  }
+  if (exact && exponent >= -22 && exponent <= 22)
+  {
+    value = (double)mantissa;
+    value = exponent < 0 ? value / EXACT_POWERS_OF_TEN[-exponent] : value * EXACT_POWERS_OF_TEN[exponent];
+    value = negative ? -value : value;
+    return true;
+  }
+  string number(start, p);
+  value = strtod(number.c_str(), NULL);
+  return true;
+}
+
+bool parseIndex(const char *&p, const char *end, long &value)
+{
+  bool negative = p < end && *p == '-';
+  const char *q = negative ? p + 1 : p;
+  if (q >= end || !isDigit(*q))
+  {
+    return false;
+  }
+  long index = 0;
+  for (; q < end && isDigit(*q); q++)
+  {
+    index = index < 1000000000000L ? index * 10 + (*q - '0') : index;
+  }
+  value = negative ? -index : index;
+  p = q;
+  return true;
+}
+
+const uint32_t MISSING = 0xffffffffu;
+
+// OBJ index (1 based, or negative from the end) into `count` elements.
+bool resolveIndex(long index, size_t count, uint32_t &resolved)
+{
+  long i = index > 0 ? index - 1 : (long)count + index;
+  if (index == 0 || i < 0 || i >= (long)count)
+  {
+    return false;
+  }
+  resolved = (uint32_t)i;
+  return true;
+}
+
+// Distinct (position, uv, normal) index triples of the faces, numbered in
+// order of first use, in an open addressing table.
+class CornerTable
+{
+public:
+  CornerTable() : slots(1024, 0) {}
+
+  // The vertex of the triple, and whether it is new.
+  uint32_t find(const uint32_t key[3], bool &added)
+  {
+    if ((keys.size() / 3 + 1) * 2 > slots.size())
+    {
+      grow();
+    }
+    size_t mask = slots.size() - 1;
+    for (size_t s = hash(key) & mask;; s = (s + 1) & mask)
+    {
+      uint32_t vertex = slots[s];
+      if (vertex == 0)
+      {
+        vertex = keys.size() / 3;
+        keys.insert(keys.end(), key, key + 3);
+        slots[s] = vertex + 1;
+        added = true;
+        return vertex;
+      }
+      const uint32_t *other = &keys[(vertex - 1) * 3];
+      if (other[0] == key[0] && other[1] == key[1] && other[2] == key[2])
+      {
+        added = false;
+        return vertex - 1;
+      }
+    }
+  }
+
+private:
+  static size_t hash(const uint32_t key[3])
+  {
+    return FlockRandom::mix(((uint64_t)key[0] << 32 | key[1]) ^ ((uint64_t)key[2] << 17));
+  }
+
+  void grow()
+  {
+    vector<uint32_t>(slots.size() * 2, 0).swap(slots);
+    size_t mask = slots.size() - 1;
+    for (uint32_t vertex = 0; vertex < keys.size() / 3; vertex++)
+    {
+      size_t s = hash(&keys[vertex * 3]) & mask;
+      while (slots[s])
+      {
+        s = (s + 1) & mask;
+      }
+      slots[s] = vertex + 1;
+    }
+  }
+
+  vector<uint32_t> slots; // vertex + 1, 0 when empty
+  vector<uint32_t> keys;  // 3 per vertex
+};
+
+string lineError(int line, const char *what)
+{
+  return "line " + to_string(line) + ": " + what;
+}
+
+} // namespace
+
+bool parseOBJ(const char *text, size_t size, IndexedMesh &mesh, string &error)
+{
+  mesh.clear();
+  vector<float> positions, uvs, normals;
+  CornerTable corners;
+  vector<uint32_t> face;
+
+  const char *p = text, *end = text + size;
+  for (int line = 1; p < end; line++)
+  {
+    skipBlanks(p, end);
+    size_t left = end - p;
+    bool position = left >= 2 && p[0] == 'v' && isBlank(p[1]);
+    bool uv = left >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2]);
+    bool normal = left >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2]);
+    bool face_line = left >= 2 && p[0] == 'f' && isBlank(p[1]);
+    double x, y, z;
+    if (position)
+    {
+      p += 2;
+      if (!parseDouble(p, end, x) || !parseDouble(p, end, y) || !parseDouble(p, end, z))
+      {
+        error = lineError(line, "a vertex needs three coordinates");
+        return false;
+      }
+      positions.push_back((float)x);
+      positions.push_back((float)y);
+      positions.push_back((float)z);
+    }
+    else if (uv)
+    {
+      p += 3;
+      if (!parseDouble(p, end, x) || !parseDouble(p, end, y))
+      {
+        error = lineError(line, "a texture coordinate needs two values");
+        return false;
+      }
+      uvs.push_back((float)x);
+      uvs.push_back((float)(1.0 - y));
+    }
+    else if (normal)
+    {
+      p += 3;
+      if (!parseDouble(p, end, x) || !parseDouble(p, end, y) || !parseDouble(p, end, z))
+      {
+        error = lineError(line, "a normal needs three coordinates");
+        return false;
+      }
+      normals.push_back((float)x);
+      normals.push_back((float)y);
+      normals.push_back((float)z);
+    }
+    else if (face_line)
+    {
+      p += 2;
+      face.clear();
+      while (true)
+      {
+        skipBlanks(p, end);
+        if (p >= end || *p == '\n' || *p == '#')
+        {
+          break;
+        }
+        long index;
+        uint32_t key[3] = {MISSING, MISSING, MISSING};
+        if (!parseIndex(p, end, index) || !resolveIndex(index, positions.size() / 3, key[0]))
+        {
+          error = lineError(line, "bad vertex index");
+          return false;
+        }
+        if (p < end && *p == '/')
+        {
+          p++;
+          if (p < end && *p != '/' &&
+              (!parseIndex(p, end, index) || !resolveIndex(index, uvs.size() / 2, key[1])))
+          {
+            error = lineError(line, "bad texture coordinate index");
+            return false;
+          }
+          if (p < end && *p == '/')
+          {
+            p++;
+            if (!parseIndex(p, end, index) || !resolveIndex(index, normals.size() / 3, key[2]))
+            {
+              error = lineError(line, "bad normal index");
+              return false;
+            }
+          }
+        }
+        bool added;
+        uint32_t vertex = corners.find(key, added);
+        if (added)
+        {
+          const float *position = &positions[key[0] * 3];
+          mesh.positions.insert(mesh.positions.end(), position, position + 3);
+          if (key[1] != MISSING)
+          {
+            mesh.uvs.insert(mesh.uvs.end(), &uvs[key[1] * 2], &uvs[key[1] * 2] + 2);
+          }
+          else
+          {
+            mesh.uvs.insert(mesh.uvs.end(), 2, 0.f);
+          }
+          if (key[2] != MISSING)
+          {
+            mesh.normals.insert(mesh.normals.end(), &normals[key[2] * 3], &normals[key[2] * 3] + 3);
+          }
+          else
+          {
+            mesh.normals.insert(mesh.normals.end(), 3, 0.f);
+          }
+        }
+        face.push_back(vertex);
+      }
+      if (face.size() < 3)
+      {
+        error = lineError(line, "a face needs at least three corners");
+        return false;
+      }
+      for (size_t k = 2; k < face.size(); k++)
+      {
+        mesh.indices.push_back(face[0]);
+        mesh.indices.push_back(face[k - 1]);
+        mesh.indices.push_back(face[k]);
+      }
+    }
+    skipLine(p, end);
+  }
+  return true;
+}
+
+uint64_t meshSourceHash(const char *data, size_t size)
+{
+  // four independent multiply chains over 8 byte words, so the hash keeps
+  // up with reading the file
+  uint64_t lanes[4] = {size, 1, 2, 3};
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32)
+  {
+    for (int lane = 0; lane < 4; lane++)
+    {
+      uint64_t word;
+      memcpy(&word, data + i + lane * 8, 8);
+      lanes[lane] = (lanes[lane] ^ word) * 0x9e3779b97f4a7c15ULL;
+      lanes[lane] ^= lanes[lane] >> 29;
+    }
+  }
+  uint64_t h = 0;
+  for (int lane = 0; lane < 4; lane++)
+  {
+    h = FlockRandom::mix(h ^ lanes[lane]);
+  }
+  for (; i < size; i++)
+  {
+    h = FlockRandom::mix(h ^ (unsigned char)data[i]);
+  }
+  return h;
+}
+
+namespace
+{
+
+// Layout of a .meshbin file: this header, then the positions, uvs and
+// normals as floats and the indices as uint32, in the byte order of the
+// machine that wrote it.
+struct MeshCacheHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t source_size;
+  uint64_t source_hash;
+  uint64_t num_vertices;
+  uint64_t num_indices;
+};
+
+const char MESH_CACHE_MAGIC[8] = {'F', 'L', 'O', 'C', 'K', 'M', 'S', 'H'};
+const uint32_t MESH_CACHE_VERSION = 1;
+const uint32_t MESH_CACHE_BYTE_ORDER = 0x01020304;
+
+size_t payloadSize(uint64_t num_vertices, uint64_t num_indices)
+{
+  return num_vertices * 8 * sizeof(float) + num_indices * sizeof(uint32_t);
+}
+
+bool readCache(const string &cache_path, uint64_t source_size, uint64_t source_hash, IndexedMesh &mesh)
+{
+  FileUtils::MappedFile file;
+  MeshCacheHeader header;
+  if (!file.open(cache_path) || file.size() < sizeof(header))
+  {
+    return false;
+  }
+  memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, MESH_CACHE_MAGIC, 8) != 0 || header.version != MESH_CACHE_VERSION ||
+      header.byte_order != MESH_CACHE_BYTE_ORDER || header.source_size != source_size ||
+      header.source_hash != source_hash || header.num_vertices > file.size() ||
+      header.num_indices > file.size() ||
+      file.size() != sizeof(header) + payloadSize(header.num_vertices, header.num_indices))
+  {
+    return false;
+  }
+  const char *p = file.data() + sizeof(header);
+  mesh.positions.resize(header.num_vertices * 3);
+  mesh.uvs.resize(header.num_vertices * 2);
+  mesh.normals.resize(header.num_vertices * 3);
+  mesh.indices.resize(header.num_indices);
+  size_t bytes = mesh.positions.size() * sizeof(float);
+  memcpy(mesh.positions.data(), p, bytes);
+  p += bytes;
+  bytes = mesh.uvs.size() * sizeof(float);
+  memcpy(mesh.uvs.data(), p, bytes);
+  p += bytes;
+  bytes = mesh.normals.size() * sizeof(float);
+  memcpy(mesh.normals.data(), p, bytes);
+  p += bytes;
+  memcpy(mesh.indices.data(), p, mesh.indices.size() * sizeof(uint32_t));
+  return true;
+}
+
+// Writes next to the final name and renames, so a reader never sees half a
+// cache.
+void writeCache(const string &cache_path, uint64_t source_size, uint64_t source_hash, const IndexedMesh &mesh)
+{
+  MeshCacheHeader header;
+  memcpy(header.magic, MESH_CACHE_MAGIC, 8);
+  header.version = MESH_CACHE_VERSION;
+  header.byte_order = MESH_CACHE_BYTE_ORDER;
+  header.source_size = source_size;
+  header.source_hash = source_hash;
+  header.num_vertices = mesh.numVertices();
+  header.num_indices = mesh.indices.size();
+
+  string temp_path = cache_path + ".tmp";
+  FILE *file = fopen(temp_path.c_str(), "wb");
+  if (!file)
+  {
+    return;
+  }
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+  written = written && fwrite(mesh.positions.data(), sizeof(float), mesh.positions.size(), file) == mesh.positions.size();
+  written = written && fwrite(mesh.uvs.data(), sizeof(float), mesh.uvs.size(), file) == mesh.uvs.size();
+  written = written && fwrite(mesh.normals.data(), sizeof(float), mesh.normals.size(), file) == mesh.normals.size();
+  written = written && fwrite(mesh.indices.data(), sizeof(uint32_t), mesh.indices.size(), file) == mesh.indices.size();
+  written = fclose(file) == 0 && written;
+#ifdef _WIN32
+  remove(cache_path.c_str());
+#endif
+  if (!written || rename(temp_path.c_str(), cache_path.c_str()) != 0)
+  {
+    remove(temp_path.c_str());
+  }
+}
+
+} // namespace
+
+bool loadMesh(const string &path, IndexedMesh &mesh, bool *from_cache)
+{
+  FileUtils::MappedFile source;
+  if (!source.open(path))
+  {
+    cout << "Error: cannot open " << path << endl;
+    return false;
+  }
+  uint64_t hash = meshSourceHash(source.data(), source.size());
+  string cache_path = path + ".meshbin";
+  bool cached = readCache(cache_path, source.size(), hash, mesh);
+  if (from_cache)
+  {
+    *from_cache = cached;
+  }
+  if (cached)
+  {
+    return true;
+  }
+  string error;
+  if (!parseOBJ(source.data(), source.size(), mesh, error))
+  {
+    cout << "Error: " << path << ", " << error << endl;
+    return false;
+  }
+  writeCache(cache_path, source.size(), hash, mesh);
+  return true;
+}
@@ -0,0 +1,43 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A triangle mesh with one vertex per distinct position/uv/normal
+// combination of the OBJ file and three indices per triangle. Vertices
+// without a uv or normal in the file have zeros there.
+struct IndexedMesh
+{
+  std::vector<float> positions; // 3 per vertex
+  std::vector<float> uvs;       // 2 per vertex, v flipped to 1 - v for GL
+  std::vector<float> normals;   // 3 per vertex
+  std::vector<uint32_t> indices;
+
+  size_t numVertices() const { return positions.size() / 3; }
+  size_t numTriangles() const { return indices.size() / 3; }
+  void clear();
+
+  // Position, normal and uv of each vertex in turn, 8 floats a vertex, the
+  // layout the viewer draws birds from.
+  std::vector<float> interleaved() const;
+};
+
+// Parses the text of a Wavefront OBJ file: v, vt and vn lines and f lines
+// with any of the v, v/vt, v//vn and v/vt/vn forms, relative (negative)
+// indices and more than three corners (split into a fan). Everything else is
+// skipped. On failure returns false with the line in `error`.
+bool parseOBJ(const char *text, size_t size, IndexedMesh &mesh, std::string &error);
+
+// Loads an OBJ file, from the binary cache next to it (path + ".meshbin")
+// when that was written for the same file contents, and otherwise by parsing
+// it and writing the cache for the next time. A cache that cannot be written
+// is not an error. `from_cache`, when given, tells which happened.
+bool loadMesh(const std::string &path, IndexedMesh &mesh, bool *from_cache = nullptr);
+
+// Hash of the file contents the cache is keyed by.
+uint64_t meshSourceHash(const char *data, size_t size);
+
+#endif /* OBJ_LOADER_H */
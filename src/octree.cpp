@@ -0,0 +1,232 @@
+#include <algorithm>
+
+#include "octree.h"
+
+using namespace std;
+
+enum OctreeRule
+{
+  RULE_COHESION = 1,
+  RULE_SEPARATION = 2,
+  RULE_ALIGNMENT = 4,
+  ALL_RULES = 7
+};
+
+void Octree::build(const FlockState &state)
+{
+  int n = state.size();
+  order.resize(n);
+  slot.resize(n);
+  nodes.clear();
+  if (n == 0)
+  {
+    return;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    order[i] = i;
+  }
+  Node root;
+  root.begin = 0;
+  root.end = n;
+  nodes.push_back(root);
+  buildNode(state, 0, 0);
+  for (int k = 0; k < n; k++)
+  {
+    slot[order[k]] = k;
+  }
+}
+
+void Octree::buildNode(const FlockState &state, int index, int depth)
+{
+  // nodes may grow below, so the node is only touched through its index
+  int begin = nodes[index].begin, end = nodes[index].end;
+  const float *pos[3] = {state.px.data(), state.py.data(), state.pz.data()};
+  const float *vel[3] = {state.vx.data(), state.vy.data(), state.vz.data()};
+  for (int k = 0; k < 3; k++)
+  {
+    float lo = pos[k][order[begin]], hi = lo;
+    double center = 0, speed = 0;
+    for (int s = begin; s < end; s++)
+    {
+      int i = order[s];
+      lo = min(lo, pos[k][i]);
+      hi = max(hi, pos[k][i]);
+      center += pos[k][i];
+      speed += vel[k][i];
+    }
+    nodes[index].lo[k] = lo;
+    nodes[index].hi[k] = hi;
+    nodes[index].center[k] = (float)(center / (end - begin));
+    nodes[index].speed[k] = (float)speed;
+  }
+  nodes[index].first_child = 0;
+  nodes[index].num_children = 0;
+  if (end - begin <= LEAF_SIZE || depth == MAX_DEPTH)
+  {
+    return;
+  }
+
+  // Split at the middle of the box into octants, one axis at a time.
+  float mid[3];
+  for (int k = 0; k < 3; k++)
+  {
+    mid[k] = (nodes[index].lo[k] + nodes[index].hi[k]) / 2;
+  }
+  int bounds[9];
+  bounds[0] = begin;
+  bounds[8] = end;
+  int *first = order.data();
+  bounds[4] = partition(first + begin, first + end, [&](int i) { return pos[0][i] < mid[0]; }) - first;
+  for (int h = 0; h < 8; h += 4)
+  {
+    bounds[h + 2] = partition(first + bounds[h], first + bounds[h + 4],
+                              [&](int i) { return pos[1][i] < mid[1]; }) - first;
+  }
+  for (int q = 0; q < 8; q += 2)
+  {
+    bounds[q + 1] = partition(first + bounds[q], first + bounds[q + 2],
+                              [&](int i) { return pos[2][i] < mid[2]; }) - first;
+  }
+
+  // Birds that sit on one point cannot be split; keep them in a leaf.
+  for (int c = 0; c < 8; c++)
+  {
+    if (bounds[c + 1] - bounds[c] == end - begin)
+    {
+      return;
+    }
+  }
+  int first_child = nodes.size();
+  for (int c = 0; c < 8; c++)
+  {
+    if (bounds[c + 1] > bounds[c])
+    {
+      Node child;
+      child.begin = bounds[c];
+      child.end = bounds[c + 1];
+      nodes.push_back(child);
+    }
+  }
+  int num_children = nodes.size() - first_child;
+  nodes[index].first_child = first_child;
+  nodes[index].num_children = num_children;
+  for (int c = first_child; c < first_child + num_children; c++)
+  {
+    buildNode(state, c, depth + 1);
+  }
+}
+
+void Octree::accumulate(const FlockState &state, SteeringKernel kernel, const SteeringQuery &query,
+                        double theta, SteeringSums &sums) const
+{
+  if (!nodes.empty())
+  {
+    accumulateNode(state, kernel, query, (float)(theta * theta), 0, ALL_RULES, sums);
+  }
+}
+
+void Octree::accumulateNode(const FlockState &state, SteeringKernel kernel, const SteeringQuery &query,
+                            float theta2, int index, int rules, SteeringSums &sums) const
+{
+  const Node &node = nodes[index];
+  const float p[3] = {query.x, query.y, query.z};
+  float dmin2 = 0, dmax2 = 0, size = 0;
+  for (int k = 0; k < 3; k++)
+  {
+    float below = node.lo[k] - p[k], above = p[k] - node.hi[k];
+    float outside = max(max(below, above), 0.f);
+    float far_side = max(-below, -above);
+    dmin2 += outside * outside;
+    dmax2 += far_side * far_side;
+    size = max(size, node.hi[k] - node.lo[k]);
+  }
+
+  const float r2[3] = {query.cohesion_r2, query.separation_r2, query.alignment_r2};
+  int whole = 0, partial = 0;
+  for (int r = 0; r < 3; r++)
+  {
+    int rule = 1 << r;
+    if (!(rules & rule) || dmin2 >= r2[r])
+    {
+      continue;
+    }
+    if (dmax2 < r2[r])
+    {
+      whole |= rule;
+    }
+    else
+    {
+      partial |= rule;
+    }
+  }
+
+  bool has_self = node.begin <= slot[query.self] && slot[query.self] < node.end;
+  float dc[3] = {node.center[0] - p[0], node.center[1] - p[1], node.center[2] - p[2]};
+  float dc2 = dc[0] * dc[0] + dc[1] * dc[1] + dc[2] * dc[2];
+  if (theta2 > 0 && !has_self && (partial & (RULE_COHESION | RULE_ALIGNMENT)) && size * size < theta2 * dc2)
+  {
+    for (int r = 0; r < 3; r += 2)
+    {
+      int rule = 1 << r;
+      if ((partial & rule) && dc2 < r2[r])
+      {
+        whole |= rule;
+      }
+    }
+    partial &= RULE_SEPARATION;
+  }
+
+  if (whole)
+  {
+    // The bird's own offset is zero, so only its count and speed come back out.
+    int count = node.end - node.begin;
+    float self_speed[3] = {0, 0, 0};
+    if (has_self)
+    {
+      count--;
+      self_speed[0] = state.vx[query.self];
+      self_speed[1] = state.vy[query.self];
+      self_speed[2] = state.vz[query.self];
+    }
+    int full = node.end - node.begin;
+    for (int k = 0; k < 3; k++)
+    {
+      if (whole & RULE_COHESION)
+      {
+        sums.cohesion[k] += dc[k] * full;
+      }
+      if (whole & RULE_SEPARATION)
+      {
+        sums.separation[k] += dc[k] * full;
+      }
+      if (whole & RULE_ALIGNMENT)
+      {
+        sums.alignment[k] += node.speed[k] - self_speed[k];
+      }
+    }
+    sums.cohesion_count += (whole & RULE_COHESION) ? count : 0;
+    sums.separation_count += (whole & RULE_SEPARATION) ? count : 0;
+    sums.alignment_count += (whole & RULE_ALIGNMENT) ? count : 0;
+  }
+  if (!partial)
+  {
+    return;
+  }
+
+  if (node.num_children == 0)
+  {
+    SteeringQuery leaf_query = query;
+    leaf_query.cohesion_r2 = (partial & RULE_COHESION) ? query.cohesion_r2 : -1;
+    leaf_query.separation_r2 = (partial & RULE_SEPARATION) ? query.separation_r2 : -1;
+    leaf_query.alignment_r2 = (partial & RULE_ALIGNMENT) ? query.alignment_r2 : -1;
+    kernel(state.px.data(), state.py.data(), state.pz.data(),
+           state.vx.data(), state.vy.data(), state.vz.data(),
+           order.data() + node.begin, node.end - node.begin, leaf_query, sums);
+    return;
+  }
+  for (int c = node.first_child; c < node.first_child + node.num_children; c++)
+  {
+    accumulateNode(state, kernel, query, theta2, c, partial, sums);
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <vector>
+
+#include "flockState.h"
+#include "steeringKernel.h"
+
+using namespace std;
+
+// Barnes-Hut octree over the flock, for flocking ranges that cover most of
+// the world.
+//
+// Every node keeps the bounding box, centroid and speed sum of its birds.
+// A query walks down from the root and, for each of the three rules, stops
+// as soon as a node lies entirely inside or entirely outside the rule's
+// radius, so a radius that covers the whole flock costs a few nodes instead
+// of N birds. Those shortcuts are exact. Nodes that straddle the cohesion or
+// alignment radius and look smaller than theta times their distance are
+// approximated by their centroid: all of their birds count if the centroid
+// is within range, none otherwise. Separation is never approximated. Leaves
+// go through the steering kernel.
+struct Octree {
+  struct Node {
+    float lo[3], hi[3]; // bounding box of the node's birds
+    float center[3];    // centroid
+    float speed[3];     // sum of speeds
+    int begin, end;     // birds order[begin .. end)
+    int first_child;    // children are nodes[first_child .. + num_children)
+    int num_children;   // 0 for a leaf
+  };
+
+  void build(const FlockState &state);
+
+  // Adds the neighbours of query.self to sums, like running the kernel over
+  // every bird. theta = 0 gives the exact sums.
+  void accumulate(const FlockState &state, SteeringKernel kernel, const SteeringQuery &query,
+                  double theta, SteeringSums &sums) const;
+
+  static const int LEAF_SIZE = 16;
+  static const int MAX_DEPTH = 24;
+
+  vector<Node> nodes; // nodes[0] is the root
+  vector<int> order;  // birds sorted so that every node is a contiguous range
+  vector<int> slot;   // slot[i] is the position of bird i in order
+
+private:
+  void buildNode(const FlockState &state, int index, int depth);
+  void accumulateNode(const FlockState &state, SteeringKernel kernel, const SteeringQuery &query,
+                      float theta2, int index, int rules, SteeringSums &sums) const;
+};
+
+#endif /* OCTREE_H */
@@ -13,7 +13,7 @@ class Halfedge;
 struct PointMass {
     PointMass(Vector3D position, bool pinned)
         : pinned(pinned), start_position(position), position(position),
-        last_position(position), speed(Vector3D(0.0001, 0, 0)) {}
+        last_position(position) {}
 
     Vector3D normal();
     Vector3D velocity(double delta_t) {
@@ -31,22 +31,6 @@ struct PointMass {
 
     // mesh reference
     Halfedge* halfedge;
-
-    // speed
-    Vector3D speed = Vector3D();
-    Vector3D cumulatedSpeed;
-
-    double minSpeed = .0002;
-    double maxSpeed = .0004;
-    double maxAcc = 1.;
-    double minAcc = 0.;
-  
-    // position to stop on the bar if "S" is pressed
-    Vector3D rand_stop_pos;
-    bool able_stop;
-    int branch = -1;
-
-    int timer = 100;
 };
 
 #endif /* POINTMASS_H */
@@ -0,0 +1,17 @@
+#ifndef SCENE_LOADER_H
+#define SCENE_LOADER_H
+
+#include <string>
+#include <vector>
+
+#include "collision/collisionObject.h"
+#include "flock.h"
+
+using namespace std;
+
+// Reads a scene/*.json file into the flock and its collision objects.
+// Shared by the viewer and flock_headless; sphere_num_lat/lon only shape the
+// sphere's render mesh.
+bool loadObjectsFromFile(string filename, Flock* flock, FlockParameters* fp, vector<CollisionObject*>* objects, int sphere_num_lat, int sphere_num_lon);
+
+#endif /* SCENE_LOADER_H */
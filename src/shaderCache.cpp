@@ -0,0 +1,173 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "shaderCache.h"
+
+#include "misc/file_utils.h"
+#include "objLoader.h"
+
+using namespace std;
+using namespace nanogui;
+
+namespace {
+
+// Layout of a .glprog file: this header, then `length` bytes of the
+// driver's binary in `format`.
+struct ProgramCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t format;
+  uint64_t key;
+  uint64_t length;
+};
+
+const char PROGRAM_CACHE_MAGIC[8] = {'F', 'L', 'O', 'C', 'K', 'P', 'R', 'G'};
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// Reports and throws like GLShader::init, which this stands in for.
+GLuint compileShader(GLenum type, const std::string &name, const std::string &source) {
+  GLuint id = glCreateShader(type);
+  const char *source_const = source.c_str();
+  glShaderSource(id, 1, &source_const, nullptr);
+  glCompileShader(id);
+
+  GLint status;
+  glGetShaderiv(id, GL_COMPILE_STATUS, &status);
+  if (status != GL_TRUE) {
+    char buffer[512];
+    std::cerr << "Error while compiling " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader \""
+              << name << "\":" << std::endl;
+    std::cerr << source << std::endl << std::endl;
+    glGetShaderInfoLog(id, 512, nullptr, buffer);
+    std::cerr << "Error: " << std::endl << buffer << std::endl;
+    throw std::runtime_error("Shader compilation failed!");
+  }
+  return id;
+}
+
+} // namespace
+
+ShaderCache::ShaderCache(const std::string &dir) : dir(dir) {
+  GLint num_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+  is_enabled = num_formats > 0 && glGetProgramBinary && glProgramBinary && FileUtils::make_directory(dir);
+  driver = string((const char *)glGetString(GL_VENDOR)) + "\n" + (const char *)glGetString(GL_RENDERER) + "\n" +
+           (const char *)glGetString(GL_VERSION);
+}
+
+uint64_t ShaderCache::key(const std::string &vertex_str, const std::string &fragment_str) const {
+  // any byte hash does; the mesh cache's is at hand
+  string text = driver + '\0' + vertex_str + '\0' + fragment_str;
+  return meshSourceHash(text.data(), text.size());
+}
+
+std::string ShaderCache::path(uint64_t key) const {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.glprog", (unsigned long long)key);
+  return dir + "/" + name;
+}
+
+GLuint ShaderCache::load(uint64_t key) const {
+  FileUtils::MappedFile file;
+  ProgramCacheHeader header;
+  if (!file.open(path(key)) || file.size() < sizeof(header)) {
+    return 0;
+  }
+  memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, PROGRAM_CACHE_MAGIC, 8) != 0 || header.version != PROGRAM_CACHE_VERSION ||
+      header.key != key || file.size() != sizeof(header) + header.length) {
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, header.format, file.data() + sizeof(header), (GLsizei)header.length);
+  GLint status;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (status != GL_TRUE) {
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+// Writes next to the final name and renames, as the mesh cache does.
+bool ShaderCache::store(uint64_t key, GLuint program) const {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return false;
+  }
+  std::vector<char> binary(length);
+  GLenum format;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+
+  ProgramCacheHeader header;
+  memcpy(header.magic, PROGRAM_CACHE_MAGIC, 8);
+  header.version = PROGRAM_CACHE_VERSION;
+  header.format = format;
+  header.key = key;
+  header.length = length;
+
+  string cache_path = path(key);
+  string temp_path = cache_path + ".tmp";
+  FILE *file = fopen(temp_path.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+  written = written && fwrite(binary.data(), 1, length, file) == (size_t)length;
+  written = fclose(file) == 0 && written;
+#ifdef _WIN32
+  remove(cache_path.c_str());
+#endif
+  if (!written || rename(temp_path.c_str(), cache_path.c_str()) != 0) {
+    remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool CachedShader::init(const std::string &name, const std::string &vertex_str, const std::string &fragment_str,
+                        ShaderCache *cache) {
+  glGenVertexArrays(1, &mVertexArrayObject);
+  mName = name;
+
+  uint64_t key = 0;
+  if (cache && cache->enabled()) {
+    key = cache->key(vertex_str, fragment_str);
+    mProgramShader = cache->load(key);
+    if (mProgramShader) {
+      cache->hits++;
+      return true;
+    }
+    cache->misses++;
+  }
+
+  mVertexShader = compileShader(GL_VERTEX_SHADER, name, vertex_str);
+  mFragmentShader = compileShader(GL_FRAGMENT_SHADER, name, fragment_str);
+  mProgramShader = glCreateProgram();
+  glAttachShader(mProgramShader, mVertexShader);
+  glAttachShader(mProgramShader, mFragmentShader);
+  if (cache && cache->enabled()) {
+    glProgramParameteri(mProgramShader, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  glLinkProgram(mProgramShader);
+
+  GLint status;
+  glGetProgramiv(mProgramShader, GL_LINK_STATUS, &status);
+  if (status != GL_TRUE) {
+    char buffer[512];
+    glGetProgramInfoLog(mProgramShader, 512, nullptr, buffer);
+    std::cerr << "Linker error (" << mName << "): " << std::endl << buffer << std::endl;
+    mProgramShader = 0;
+    throw std::runtime_error("Shader linking failed!");
+  }
+
+  if (cache && cache->enabled()) {
+    cache->store(key, mProgramShader);
+  }
+  return true;
+}
@@ -0,0 +1,49 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include <nanogui/glutil.h>
+
+// Linked GL programs saved with glGetProgramBinary, one file a program in a
+// directory, so that later runs hand the driver its own binary instead of
+// compiling the sources again.
+//
+// A program is found by a hash of its sources and of the vendor, renderer
+// and version strings, so editing a shader or changing the driver simply
+// misses, and a binary the driver still refuses is recompiled and replaced.
+// Drivers without binary formats (or a directory that cannot be made) leave
+// the cache disabled and everything is compiled as before.
+class ShaderCache {
+public:
+  // Needs the GL context current.
+  ShaderCache(const std::string &dir);
+
+  bool enabled() const { return is_enabled; }
+  uint64_t key(const std::string &vertex_str, const std::string &fragment_str) const;
+
+  // The linked program, or 0 when there is none or the driver rejects it.
+  GLuint load(uint64_t key) const;
+  bool store(uint64_t key, GLuint program) const;
+
+  // Of this run.
+  mutable int hits = 0, misses = 0;
+
+private:
+  std::string path(uint64_t key) const;
+
+  std::string dir;
+  std::string driver;
+  bool is_enabled = false;
+};
+
+// A GLShader linked through the cache.
+class CachedShader : public nanogui::GLShader {
+public:
+  // As GLShader::init, without geometry shaders or definitions.
+  bool init(const std::string &name, const std::string &vertex_str, const std::string &fragment_str,
+            ShaderCache *cache);
+};
+
+#endif /* SHADER_CACHE_H */
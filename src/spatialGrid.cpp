@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <limits>
+
+#include "spatialGrid.h"
+
+using namespace std;
+
+// Upper bound on the number of cells, so a tiny query radius or a single
+// stray bird far from the flock cannot blow up the cell array.
+static const int MIN_CELL_BUDGET = 4096;
+static const int CELLS_PER_BIRD = 4;
+
+void SpatialGrid::cellCoords(const Vector3D &pos, int &cx, int &cy, int &cz) const {
+  // Written so that NaN positions fall into cell 0 instead of overflowing.
+  double fx = (pos.x - origin.x) * inv_cell_size;
+  double fy = (pos.y - origin.y) * inv_cell_size;
+  double fz = (pos.z - origin.z) * inv_cell_size;
+  cx = fx > 0 ? (int)min(fx, (double)(dim_x - 1)) : 0;
+  cy = fy > 0 ? (int)min(fy, (double)(dim_y - 1)) : 0;
+  cz = fz > 0 ? (int)min(fz, (double)(dim_z - 1)) : 0;
+}
+
+const int SpatialGrid::COMPACT_UPDATES;
+const int SpatialGrid::MAX_MIGRATION_SHARE;
+const int SpatialGrid::SLACK_SHARE;
+const int SpatialGrid::MIN_SLACK;
+
+void SpatialGrid::build(const FlockState &state, double cell_size)
+{
+  int n = state.size();
+  row_end.clear();
+  requested_size = cell_size;
+  entries.resize(n);
+  bird_cell.resize(n);
+  if (n == 0) {
+    cell_start.assign(1, 0);
+    dim_x = dim_y = dim_z = 0;
+    return;
+  }
+
+  Vector3D lo(numeric_limits<double>::max());
+  Vector3D hi(-numeric_limits<double>::max());
+  const float *pos[3] = {state.px.data(), state.py.data(), state.pz.data()};
+  for (int k = 0; k < 3; k++) {
+    // NaN positions never pass the comparisons, so they are skipped
+    float low = numeric_limits<float>::max(), high = -numeric_limits<float>::max();
+    const float *p = pos[k];
+    #pragma omp parallel for reduction(min : low) reduction(max : high) if (n >= CellSort::MIN_PARALLEL_BIRDS)
+    for (int i = 0; i < n; i++) {
+      if (p[i] < low) low = p[i];
+      if (p[i] > high) high = p[i];
+    }
+    lo[k] = low;
+    hi[k] = high;
+  }
+  if (lo.x > hi.x) { // every position was NaN
+    lo = hi = Vector3D();
+  }
+
+  // Growing the cells keeps the 27-cell query exact, it only adds candidates.
+  int budget = max(MIN_CELL_BUDGET, CELLS_PER_BIRD * n);
+  cell_start.reserve(budget + 1); // so later builds of this flock never reallocate
+  cell_size = max(cell_size, 1e-6);
+  Vector3D extent = hi - lo;
+  while (true) {
+    double cells = 1;
+    for (int k = 0; k < 3; k++) {
+      cells *= floor(extent[k] / cell_size) + 1;
+    }
+    if (cells <= budget) {
+      break;
+    }
+    cell_size *= 1.25;
+  }
+
+  this->cell_size = cell_size;
+  inv_cell_size = 1. / cell_size;
+  origin = lo;
+  dim_x = (int)floor(extent.x / cell_size) + 1;
+  dim_y = (int)floor(extent.y / cell_size) + 1;
+  dim_z = (int)floor(extent.z / cell_size) + 1;
+
+  #pragma omp parallel for if (n >= CellSort::MIN_PARALLEL_BIRDS)
+  for (int i = 0; i < n; i++) {
+    int cx, cy, cz;
+    cellCoords(state.position(i), cx, cy, cz);
+    bird_cell[i] = cellIndex(cx, cy, cz);
+  }
+  sorter.sort(bird_cell.data(), n, numCells(), cell_start, entries);
+}
+
+void SpatialGrid::buildWithSlack(const FlockState &state, double cell_size)
+{
+  build(state, cell_size);
+  int n = state.size();
+  int num_rows = dim_y * dim_z;
+  int budget = max(MIN_CELL_BUDGET, CELLS_PER_BIRD * n);
+  // the most any build of this flock can need, so updates never reallocate
+  entries.reserve(n + n / SLACK_SHARE + MIN_SLACK * budget);
+  row_end.reserve(budget);
+  row_end.resize(num_rows);
+  entry_of.resize(n);
+  next_cell.resize(n);
+
+  int total = n;
+  for (int r = 0; r < num_rows; r++) {
+    row_end[r] = cell_start[(r + 1) * dim_x] - cell_start[r * dim_x]; // count for now
+    total += row_end[r] / SLACK_SHARE + MIN_SLACK;
+  }
+  // Spread the rows out from the last one down: every row only moves up,
+  // and never onto the rows below it that are still to move.
+  entries.resize(total);
+  cell_start[numCells()] = total;
+  for (int r = num_rows - 1; r >= 0; r--) {
+    int first = r * dim_x;
+    int count = row_end[r];
+    int shift = total - count - count / SLACK_SHARE - MIN_SLACK - cell_start[first];
+    for (int e = cell_start[first] + count - 1; e >= cell_start[first]; e--) {
+      entries[e + shift] = entries[e];
+      entry_of[entries[e + shift]] = e + shift;
+    }
+    for (int c = first; c < first + dim_x; c++) {
+      cell_start[c] += shift;
+    }
+    row_end[r] = cell_start[first] + count;
+    total = cell_start[first];
+  }
+  updates = 0;
+}
+
+void SpatialGrid::remove(int i, int c)
+{
+  // The last bird of the cell fills the hole, then every later cell of the
+  // row starts one earlier, its last bird filling the hole it leaves.
+  int hole = entry_of[i];
+  moveEntry(cellEnd(c) - 1, hole);
+  hole = cellEnd(c) - 1;
+  int row = c / dim_x;
+  for (int d = c + 1; d < (row + 1) * dim_x; d++) {
+    int end = cellEnd(d);
+    cell_start[d]--;
+    if (end - 1 > hole) {
+      moveEntry(end - 1, hole);
+    }
+    hole = end - 1;
+  }
+  row_end[row]--;
+}
+
+bool SpatialGrid::insert(int i, int c)
+{
+  int row = c / dim_x;
+  if (row_end[row] == cell_start[(row + 1) * dim_x]) {
+    return false;
+  }
+  // Every later cell of the row starts one later, its first bird moving to
+  // its end, which leaves a hole at the end of cell c.
+  int hole = row_end[row]++;
+  for (int d = (row + 1) * dim_x - 1; d > c; d--) {
+    int start = cell_start[d];
+    if (hole > start) {
+      moveEntry(start, hole);
+    }
+    cell_start[d]++;
+    hole = start;
+  }
+  entries[hole] = i;
+  entry_of[i] = hole;
+  return true;
+}
+
+int SpatialGrid::update(const FlockState &state, double cell_size)
+{
+  int n = state.size();
+  if (row_end.empty() || n != (int)entry_of.size() || cell_size != requested_size ||
+      updates >= COMPACT_UPDATES) {
+    buildWithSlack(state, cell_size);
+    return -1;
+  }
+
+  int migrations = 0;
+  #pragma omp parallel for reduction(+ : migrations) if (n >= CellSort::MIN_PARALLEL_BIRDS)
+  for (int i = 0; i < n; i++) {
+    int cx, cy, cz;
+    cellCoords(state.position(i), cx, cy, cz);
+    next_cell[i] = cellIndex(cx, cy, cz);
+    migrations += next_cell[i] != bird_cell[i];
+  }
+  if (migrations > n / MAX_MIGRATION_SHARE) {
+    buildWithSlack(state, cell_size);
+    return -1;
+  }
+
+  // One bird at a time in index order, so the cells come out the same for
+  // any number of threads.
+  for (int i = 0, left = migrations; left > 0 && i < n; i++) {
+    if (next_cell[i] == bird_cell[i]) {
+      continue;
+    }
+    remove(i, bird_cell[i]);
+    if (!insert(i, next_cell[i])) {
+      buildWithSlack(state, cell_size);
+      return -1;
+    }
+    bird_cell[i] = next_cell[i];
+    left--;
+  }
+  updates++;
+  return migrations;
+}
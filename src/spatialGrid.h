@@ -0,0 +1,129 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <vector>
+
+#include "CGL/CGL.h"
+#include "CGL/vector3D.h"
+#include "cellSort.h"
+#include "flockState.h"
+
+using namespace CGL;
+using namespace std;
+
+// Uniform cell list over the bounding box of the flock.
+//
+// The grid is rebuilt from scratch with a parallel counting sort (see
+// CellSort), so the birds of each cell end up contiguous in `entries`. With
+// a cell size at least as large as the biggest query radius, every neighbour
+// of a bird lies in one of the 27 cells around it.
+//
+// Birds rarely leave their cell between steps, so update() can instead keep
+// the grid and move only the birds that changed cell. Its builds leave
+// slack at the end of every row of cells along x, so a row stays one run
+// and a move only shifts the cells after it in the two rows. A full rebuild
+// compacts the rows again when one runs out of room, when many birds moved,
+// or every COMPACT_UPDATES updates so the box keeps up with the flock. Birds
+// that leave the box land in the border cells, which keeps the queries
+// exact, only slower.
+struct SpatialGrid {
+  SpatialGrid() : cell_size(1), inv_cell_size(1), dim_x(0), dim_y(0), dim_z(0), requested_size(0),
+                  updates(0) {}
+
+  void build(const FlockState &state, double cell_size);
+  // Incremental build: returns how many birds changed cell, or -1 if the
+  // grid was built from scratch instead.
+  int update(const FlockState &state, double cell_size);
+  // Makes the next update() build from scratch, for when the birds were
+  // renumbered.
+  void invalidate() { row_end.clear(); }
+
+  // Calls visit(index) for every bird in the 27 cells around pos.
+  template <typename Visitor>
+  void query(const Vector3D &pos, Visitor visit) const;
+
+  // Same cells, handed out as the contiguous runs of `entries` they occupy:
+  // calls visit_run(indices, count) at most 9 times.
+  template <typename RunVisitor>
+  void queryRuns(const Vector3D &pos, RunVisitor visit_run) const;
+
+  void cellCoords(const Vector3D &pos, int &cx, int &cy, int &cz) const;
+  int cellIndex(int cx, int cy, int cz) const {
+    return (cz * dim_y + cy) * dim_x + cx;
+  }
+  int numCells() const { return dim_x * dim_y * dim_z; }
+  // End of the birds of cell c in entries.
+  int cellEnd(int c) const {
+    return row_end.empty() || (c + 1) % dim_x != 0 ? cell_start[c + 1] : row_end[c / dim_x];
+  }
+
+  double cell_size;
+  double inv_cell_size;
+  Vector3D origin;
+  int dim_x, dim_y, dim_z;
+
+  // Birds of cell c are entries[cell_start[c] .. cellEnd(c)).
+  vector<int> cell_start;
+  vector<int> entries;
+  vector<int> bird_cell;
+  CellSort sorter;
+
+  // update() state: row_end is empty after build(), else it ends the birds
+  // of each row, whose slack runs up to the start of the next row.
+  vector<int> row_end;
+  vector<int> entry_of; // position of each bird in entries
+  vector<int> next_cell;
+  double requested_size;
+  int updates; // since the last full build
+
+  static const int COMPACT_UPDATES = 64;
+  // Fall back to a full build when more than 1 / MAX_MIGRATION_SHARE of the
+  // birds changed cell.
+  static const int MAX_MIGRATION_SHARE = 16;
+  // Each row gets room for count / SLACK_SHARE + MIN_SLACK more birds.
+  static const int SLACK_SHARE = 8;
+  static const int MIN_SLACK = 4;
+
+private:
+  void buildWithSlack(const FlockState &state, double cell_size);
+  // Move bird i out of cell c, or into it; false if its row is full.
+  void remove(int i, int c);
+  bool insert(int i, int c);
+  void moveEntry(int from, int to) {
+    entries[to] = entries[from];
+    entry_of[entries[to]] = to;
+  }
+};
+
+template <typename Visitor>
+void SpatialGrid::query(const Vector3D &pos, Visitor visit) const {
+  queryRuns(pos, [&](const int *indices, int count) {
+    for (int e = 0; e < count; e++) {
+      visit(indices[e]);
+    }
+  });
+}
+
+template <typename RunVisitor>
+void SpatialGrid::queryRuns(const Vector3D &pos, RunVisitor visit_run) const {
+  if (entries.empty()) {
+    return;
+  }
+  int cx, cy, cz;
+  cellCoords(pos, cx, cy, cz);
+  int x0 = max(cx - 1, 0), x1 = min(cx + 1, dim_x - 1);
+  int y0 = max(cy - 1, 0), y1 = min(cy + 1, dim_y - 1);
+  int z0 = max(cz - 1, 0), z1 = min(cz + 1, dim_z - 1);
+  for (int z = z0; z <= z1; z++) {
+    for (int y = y0; y <= y1; y++) {
+      // Cells along x are adjacent, so the whole row is one contiguous run.
+      int begin = cell_start[cellIndex(x0, y, z)];
+      int end = cellEnd(cellIndex(x1, y, z));
+      if (end > begin) {
+        visit_run(&entries[begin], end - begin);
+      }
+    }
+  }
+}
+
+#endif /* SPATIAL_GRID_H */
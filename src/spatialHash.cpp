@@ -0,0 +1,66 @@
+#include <cmath>
+
+#include "spatialHash.h"
+
+using namespace std;
+
+const uint64_t SpatialHash::EMPTY;
+
+// Finalizer of MurmurHash3, spreads neighbouring keys over the table.
+static uint64_t mixKey(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  return k;
+}
+
+// NaN and huge coordinates go to cell 0 instead of overflowing the cast.
+static int64_t cellCoord(double v) {
+  double f = floor(v);
+  return fabs(f) < 1e18 ? (int64_t)f : 0;
+}
+
+uint64_t SpatialHash::cellKey(const Vector3D &pos, const Vector3D &cell_size) {
+  return cellKey(cellCoord(pos.x / cell_size.x), cellCoord(pos.y / cell_size.y),
+                 cellCoord(pos.z / cell_size.z));
+}
+
+int SpatialHash::findSlot(uint64_t key) const {
+  size_t mask = slot_key.size() - 1;
+  size_t s = mixKey(key) & mask;
+  while (slot_key[s] != key && slot_key[s] != EMPTY) {
+    s = (s + 1) & mask;
+  }
+  return (int)s;
+}
+
+void SpatialHash::build(const FlockState &state, const Vector3D &cell_size)
+{
+  this->cell_size = cell_size;
+  int n = state.size();
+  size_t table_size = 16;
+  while (table_size < 2 * (size_t)n) {
+    table_size *= 2;
+  }
+  slot_key.assign(table_size, EMPTY);
+  slot_cell.assign(table_size, -1);
+  bird_key.resize(n);
+  bird_cell.resize(n);
+
+  #pragma omp parallel for if (n >= CellSort::MIN_PARALLEL_BIRDS)
+  for (int i = 0; i < n; i++) {
+    bird_key[i] = key(state.position(i));
+  }
+  // Number the occupied cells in order of first appearance, which keeps the
+  // numbering independent of the thread count, then sort as SpatialGrid does.
+  num_cells = 0;
+  for (int i = 0; i < n; i++) {
+    int s = findSlot(bird_key[i]);
+    if (slot_key[s] == EMPTY) {
+      slot_key[s] = bird_key[i];
+      slot_cell[s] = num_cells++;
+    }
+    bird_cell[i] = slot_cell[s];
+  }
+  sorter.sort(bird_cell.data(), n, num_cells, cell_start, entries);
+}
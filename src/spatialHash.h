@@ -0,0 +1,79 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "CGL/CGL.h"
+#include "CGL/vector3D.h"
+#include "cellSort.h"
+#include "flockState.h"
+
+using namespace CGL;
+using namespace std;
+
+// Unbounded hashed cell list: only occupied cells are stored, so the cells
+// can be small whatever the spread of the flock.
+//
+// Cells are keyed by their integer coordinates packed into 64 bits and found
+// through an open addressing table. A rebuild sorts the birds into one
+// arena, `entries`, where the birds of each cell are contiguous. All
+// arrays keep their capacity, so rebuilding a flock of the same size does
+// not touch the heap.
+struct SpatialHash {
+  SpatialHash() : cell_size(1, 1, 1), num_cells(0) {}
+
+  // cell_size may differ per axis.
+  void build(const FlockState &state, const Vector3D &cell_size);
+
+  // 21 bits per coordinate, enough for cells from -2^20 to 2^20 - 1; larger
+  // coordinates wrap, which only makes far away cells share a key.
+  static uint64_t cellKey(int64_t cx, int64_t cy, int64_t cz) {
+    const uint64_t mask = (1 << 21) - 1;
+    return ((uint64_t)cx & mask) | ((uint64_t)cy & mask) << 21 | ((uint64_t)cz & mask) << 42;
+  }
+  // Key of the cell of pos.
+  static uint64_t cellKey(const Vector3D &pos, const Vector3D &cell_size);
+  uint64_t key(const Vector3D &pos) const { return cellKey(pos, cell_size); }
+
+  // Calls visit(index) for every bird in the cell of pos.
+  template <typename Visitor>
+  void query(const Vector3D &pos, Visitor visit) const;
+
+  int numCells() const { return num_cells; }
+
+  Vector3D cell_size;
+  int num_cells;
+
+  // Open addressing table: slot_key[s] is EMPTY or the key of cell
+  // slot_cell[s]. Its size is a power of two, at least twice the birds.
+  static const uint64_t EMPTY = ~(uint64_t)0;
+  vector<uint64_t> slot_key;
+  vector<int> slot_cell;
+
+  // Birds of cell c are entries[cell_start[c] .. cell_start[c + 1]).
+  vector<int> cell_start;
+  vector<int> entries;
+  vector<int> bird_cell;
+  vector<uint64_t> bird_key;
+  CellSort sorter;
+
+private:
+  int findSlot(uint64_t key) const;
+};
+
+template <typename Visitor>
+void SpatialHash::query(const Vector3D &pos, Visitor visit) const {
+  if (slot_key.empty()) {
+    return;
+  }
+  int cell = slot_cell[findSlot(key(pos))];
+  if (cell < 0) {
+    return;
+  }
+  for (int k = cell_start[cell]; k < cell_start[cell + 1]; k++) {
+    visit(entries[k]);
+  }
+}
+
+#endif /* SPATIAL_HASH_H */
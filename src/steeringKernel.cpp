@@ -0,0 +1,315 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "steeringKernel.h"
+
+// The SIMD kernels are compiled with per-function target attributes, so the
+// rest of the project keeps its default flags and still runs on any x86-64.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define STEERING_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+static void accumulateScalar(const float *px, const float *py, const float *pz,
+                             const float *vx, const float *vy, const float *vz,
+                             const int *indices, int count,
+                             const SteeringQuery &query, SteeringSums &sums)
+{
+  for (int k = 0; k < count; k++)
+  {
+    int j = indices[k];
+    if (j == query.self)
+    {
+      continue;
+    }
+    float dx = px[j] - query.x;
+    float dy = py[j] - query.y;
+    float dz = pz[j] - query.z;
+    float d2 = dx * dx + dy * dy + dz * dz;
+    if (d2 < query.cohesion_r2)
+    {
+      sums.cohesion[0] += dx;
+      sums.cohesion[1] += dy;
+      sums.cohesion[2] += dz;
+      sums.cohesion_count++;
+    }
+    if (d2 < query.separation_r2)
+    {
+      sums.separation[0] += dx;
+      sums.separation[1] += dy;
+      sums.separation[2] += dz;
+      sums.separation_count++;
+    }
+    if (d2 < query.alignment_r2)
+    {
+      sums.alignment[0] += vx[j];
+      sums.alignment[1] += vy[j];
+      sums.alignment[2] += vz[j];
+      sums.alignment_count++;
+    }
+  }
+}
+
+#ifdef STEERING_KERNEL_X86
+
+__attribute__((target("avx2")))
+static inline float horizontalSum(__m256 v)
+{
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+// The distance is computed with separate multiplies and adds (no FMA) so the
+// neighbour test agrees exactly with the scalar kernel.
+__attribute__((target("avx2")))
+static void accumulateAvx2(const float *px, const float *py, const float *pz,
+                           const float *vx, const float *vy, const float *vz,
+                           const int *indices, int count,
+                           const SteeringQuery &query, SteeringSums &sums)
+{
+  const __m256 qx = _mm256_set1_ps(query.x);
+  const __m256 qy = _mm256_set1_ps(query.y);
+  const __m256 qz = _mm256_set1_ps(query.z);
+  const __m256 cohesion_r2 = _mm256_set1_ps(query.cohesion_r2);
+  const __m256 separation_r2 = _mm256_set1_ps(query.separation_r2);
+  const __m256 alignment_r2 = _mm256_set1_ps(query.alignment_r2);
+  const __m256i self = _mm256_set1_epi32(query.self);
+  const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+  __m256 cx = _mm256_setzero_ps(), cy = cx, cz = cx;
+  __m256 sx = cx, sy = cx, sz = cx;
+  __m256 ax = cx, ay = cx, az = cx;
+  int cohesion_count = 0, separation_count = 0, alignment_count = 0;
+
+  for (int k = 0; k < count; k += 8)
+  {
+    __m256i idx;
+    if (k + 8 <= count)
+    {
+      idx = _mm256_loadu_si256((const __m256i *)(indices + k));
+    }
+    else
+    {
+      // Pad the tail with the bird itself, which the self test drops.
+      __m256i live = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - k), lane);
+      idx = _mm256_maskload_epi32(indices + k, live);
+      idx = _mm256_blendv_epi8(self, idx, live);
+    }
+    __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(px, idx, 4), qx);
+    __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(py, idx, 4), qy);
+    __m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(pz, idx, 4), qz);
+    __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                              _mm256_mul_ps(dz, dz));
+    __m256 is_self = _mm256_castsi256_ps(_mm256_cmpeq_epi32(idx, self));
+
+    __m256 mc = _mm256_andnot_ps(is_self, _mm256_cmp_ps(d2, cohesion_r2, _CMP_LT_OQ));
+    __m256 ms = _mm256_andnot_ps(is_self, _mm256_cmp_ps(d2, separation_r2, _CMP_LT_OQ));
+    __m256 ma = _mm256_andnot_ps(is_self, _mm256_cmp_ps(d2, alignment_r2, _CMP_LT_OQ));
+
+    cx = _mm256_add_ps(cx, _mm256_and_ps(mc, dx));
+    cy = _mm256_add_ps(cy, _mm256_and_ps(mc, dy));
+    cz = _mm256_add_ps(cz, _mm256_and_ps(mc, dz));
+    sx = _mm256_add_ps(sx, _mm256_and_ps(ms, dx));
+    sy = _mm256_add_ps(sy, _mm256_and_ps(ms, dy));
+    sz = _mm256_add_ps(sz, _mm256_and_ps(ms, dz));
+    cohesion_count += __builtin_popcount(_mm256_movemask_ps(mc));
+    separation_count += __builtin_popcount(_mm256_movemask_ps(ms));
+
+    int align_bits = _mm256_movemask_ps(ma);
+    if (align_bits)
+    {
+      ax = _mm256_add_ps(ax, _mm256_and_ps(ma, _mm256_i32gather_ps(vx, idx, 4)));
+      ay = _mm256_add_ps(ay, _mm256_and_ps(ma, _mm256_i32gather_ps(vy, idx, 4)));
+      az = _mm256_add_ps(az, _mm256_and_ps(ma, _mm256_i32gather_ps(vz, idx, 4)));
+      alignment_count += __builtin_popcount(align_bits);
+    }
+  }
+
+  sums.cohesion[0] += horizontalSum(cx);
+  sums.cohesion[1] += horizontalSum(cy);
+  sums.cohesion[2] += horizontalSum(cz);
+  sums.separation[0] += horizontalSum(sx);
+  sums.separation[1] += horizontalSum(sy);
+  sums.separation[2] += horizontalSum(sz);
+  sums.alignment[0] += horizontalSum(ax);
+  sums.alignment[1] += horizontalSum(ay);
+  sums.alignment[2] += horizontalSum(az);
+  sums.cohesion_count += cohesion_count;
+  sums.separation_count += separation_count;
+  sums.alignment_count += alignment_count;
+}
+
+// Zero-masked extracts, because GCC 12's unmasked extract and cast
+// intrinsics warn about the undefined source operand they use internally.
+__attribute__((target("avx512f")))
+static inline float horizontalSum512(__m512 v)
+{
+  __m256 lo = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xf, _mm512_castps_pd(v), 0));
+  __m256 hi = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xf, _mm512_castps_pd(v), 1));
+  __m256 s8 = _mm256_add_ps(lo, hi);
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx512f")))
+static void accumulateAvx512(const float *px, const float *py, const float *pz,
+                             const float *vx, const float *vy, const float *vz,
+                             const int *indices, int count,
+                             const SteeringQuery &query, SteeringSums &sums)
+{
+  const __m512 qx = _mm512_set1_ps(query.x);
+  const __m512 qy = _mm512_set1_ps(query.y);
+  const __m512 qz = _mm512_set1_ps(query.z);
+  const __m512 cohesion_r2 = _mm512_set1_ps(query.cohesion_r2);
+  const __m512 separation_r2 = _mm512_set1_ps(query.separation_r2);
+  const __m512 alignment_r2 = _mm512_set1_ps(query.alignment_r2);
+  const __m512i self = _mm512_set1_epi32(query.self);
+  const __m512 zero = _mm512_setzero_ps();
+
+  __m512 cx = zero, cy = cx, cz = cx;
+  __m512 sx = cx, sy = cx, sz = cx;
+  __m512 ax = cx, ay = cx, az = cx;
+  int cohesion_count = 0, separation_count = 0, alignment_count = 0;
+
+  for (int k = 0; k < count; k += 16)
+  {
+    __mmask16 live = count - k >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (count - k)) - 1);
+    // Lanes past the end keep the index of the bird itself.
+    __m512i idx = _mm512_mask_loadu_epi32(self, live, indices + k);
+    __mmask16 other = _mm512_cmpneq_epi32_mask(idx, self);
+
+    __m512 dx = _mm512_sub_ps(_mm512_mask_i32gather_ps(zero, live, idx, px, 4), qx);
+    __m512 dy = _mm512_sub_ps(_mm512_mask_i32gather_ps(zero, live, idx, py, 4), qy);
+    __m512 dz = _mm512_sub_ps(_mm512_mask_i32gather_ps(zero, live, idx, pz, 4), qz);
+    __m512 d2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)),
+                              _mm512_mul_ps(dz, dz));
+
+    __mmask16 mc = _mm512_mask_cmp_ps_mask(other, d2, cohesion_r2, _CMP_LT_OQ);
+    __mmask16 ms = _mm512_mask_cmp_ps_mask(other, d2, separation_r2, _CMP_LT_OQ);
+    __mmask16 ma = _mm512_mask_cmp_ps_mask(other, d2, alignment_r2, _CMP_LT_OQ);
+
+    cx = _mm512_mask_add_ps(cx, mc, cx, dx);
+    cy = _mm512_mask_add_ps(cy, mc, cy, dy);
+    cz = _mm512_mask_add_ps(cz, mc, cz, dz);
+    sx = _mm512_mask_add_ps(sx, ms, sx, dx);
+    sy = _mm512_mask_add_ps(sy, ms, sy, dy);
+    sz = _mm512_mask_add_ps(sz, ms, sz, dz);
+    cohesion_count += __builtin_popcount(mc);
+    separation_count += __builtin_popcount(ms);
+
+    if (ma)
+    {
+      ax = _mm512_mask_add_ps(ax, ma, ax, _mm512_mask_i32gather_ps(ax, ma, idx, vx, 4));
+      ay = _mm512_mask_add_ps(ay, ma, ay, _mm512_mask_i32gather_ps(ay, ma, idx, vy, 4));
+      az = _mm512_mask_add_ps(az, ma, az, _mm512_mask_i32gather_ps(az, ma, idx, vz, 4));
+      alignment_count += __builtin_popcount(ma);
+    }
+  }
+
+  sums.cohesion[0] += horizontalSum512(cx);
+  sums.cohesion[1] += horizontalSum512(cy);
+  sums.cohesion[2] += horizontalSum512(cz);
+  sums.separation[0] += horizontalSum512(sx);
+  sums.separation[1] += horizontalSum512(sy);
+  sums.separation[2] += horizontalSum512(sz);
+  sums.alignment[0] += horizontalSum512(ax);
+  sums.alignment[1] += horizontalSum512(ay);
+  sums.alignment[2] += horizontalSum512(az);
+  sums.cohesion_count += cohesion_count;
+  sums.separation_count += separation_count;
+  sums.alignment_count += alignment_count;
+}
+
+#endif // STEERING_KERNEL_X86
+
+static bool cpuSupports(SteeringKernelType type)
+{
+#ifdef STEERING_KERNEL_X86
+  __builtin_cpu_init();
+  switch (type)
+  {
+  case STEERING_KERNEL_AVX512:
+    return __builtin_cpu_supports("avx512f");
+  case STEERING_KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2");
+  default:
+    return true;
+  }
+#else
+  return type == STEERING_KERNEL_SCALAR;
+#endif
+}
+
+SteeringKernel steeringKernel(SteeringKernelType type)
+{
+  if (!cpuSupports(type))
+  {
+    return nullptr;
+  }
+  switch (type)
+  {
+#ifdef STEERING_KERNEL_X86
+  case STEERING_KERNEL_AVX512:
+    return accumulateAvx512;
+  case STEERING_KERNEL_AVX2:
+    return accumulateAvx2;
+#endif
+  case STEERING_KERNEL_SCALAR:
+    return accumulateScalar;
+  default:
+    return nullptr;
+  }
+}
+
+const char *steeringKernelName(SteeringKernelType type)
+{
+  switch (type)
+  {
+  case STEERING_KERNEL_AVX512:
+    return "avx512";
+  case STEERING_KERNEL_AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+static SteeringKernelType pickKernelType()
+{
+  int widest = STEERING_KERNEL_AVX512;
+  const char *requested = getenv("FLOCK_SIMD");
+  if (requested)
+  {
+    for (int type = STEERING_KERNEL_SCALAR; type <= STEERING_KERNEL_AVX512; type++)
+    {
+      if (strcmp(requested, steeringKernelName((SteeringKernelType)type)) == 0)
+      {
+        widest = type;
+      }
+    }
+  }
+  for (int type = widest; type > STEERING_KERNEL_SCALAR; type--)
+  {
+    if (steeringKernel((SteeringKernelType)type))
+    {
+      return (SteeringKernelType)type;
+    }
+  }
+  return STEERING_KERNEL_SCALAR;
+}
+
+SteeringKernelType steeringKernelType()
+{
+  static const SteeringKernelType type = pickKernelType();
+  return type;
+}
+
+SteeringKernel steeringKernel()
+{
+  static const SteeringKernel kernel = steeringKernel(steeringKernelType());
+  return kernel;
+}
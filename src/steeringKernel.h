@@ -0,0 +1,60 @@
+#ifndef STEERING_KERNEL_H
+#define STEERING_KERNEL_H
+
+// Fused neighbour loop for the three flocking rules.
+//
+// One call takes a list of candidate birds (usually a contiguous run of the
+// neighbour grid) and does the distance test against every candidate together
+// with all three accumulations: the cohesion offset sum, the separation
+// offset sum and the alignment speed sum. The candidates are gathered from
+// the structure-of-arrays float buffers of FlockState, 8 (AVX2) or 16
+// (AVX-512) at a time.
+
+// Bird that the neighbours are collected for. Radii are squared.
+struct SteeringQuery {
+  float x, y, z;
+  float cohesion_r2, separation_r2, alignment_r2;
+  int self; // index of the bird itself, never counted as a neighbour
+};
+
+// Running sums of one query. Offsets are neighbour position minus the query
+// position, which keeps the float sums small whatever the flock's location.
+struct SteeringSums {
+  SteeringSums() { clear(); }
+  void clear() {
+    cohesion[0] = cohesion[1] = cohesion[2] = 0;
+    separation[0] = separation[1] = separation[2] = 0;
+    alignment[0] = alignment[1] = alignment[2] = 0;
+    cohesion_count = separation_count = alignment_count = 0;
+  }
+
+  float cohesion[3];   // sum of offsets within the cohesion radius
+  float separation[3]; // sum of offsets within the separation radius
+  float alignment[3];  // sum of speeds within the alignment radius
+  int cohesion_count, separation_count, alignment_count;
+};
+
+// Candidate birds are px[indices[k]] etc. for k in [0, count).
+typedef void (*SteeringKernel)(const float *px, const float *py, const float *pz,
+                               const float *vx, const float *vy, const float *vz,
+                               const int *indices, int count,
+                               const SteeringQuery &query, SteeringSums &sums);
+
+enum SteeringKernelType {
+  STEERING_KERNEL_SCALAR,
+  STEERING_KERNEL_AVX2,
+  STEERING_KERNEL_AVX512
+};
+
+// Picks the widest kernel the CPU supports the first time it is called. The
+// FLOCK_SIMD environment variable (scalar, avx2 or avx512) lowers the choice,
+// which is handy to compare results and timings on one machine.
+SteeringKernelType steeringKernelType();
+SteeringKernel steeringKernel();
+
+// Returns the kernel of the given type, or null if this build or CPU cannot
+// run it.
+SteeringKernel steeringKernel(SteeringKernelType type);
+const char *steeringKernelName(SteeringKernelType type);
+
+#endif /* STEERING_KERNEL_H */